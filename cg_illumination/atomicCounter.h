@@ -0,0 +1,94 @@
+#pragma once
+
+#include <iostream>
+
+#include <glad/glad.h>
+
+// GPU counter that shaders increment through an atomic_uint at binding point binding.
+// Each frame counts into its own buffer and the result is read a few frames later, once the fence of that frame
+// has passed, so reading the counter never stalls the pipeline. getValue() is the last count that arrived.
+// Frames that draw nothing counted can skip begin() and end(), update() still collects the counts in flight.
+class AtomicCounter{
+private:
+	static const unsigned NR_OF_BUFFERS = 3;
+
+	GLuint buffers[NR_OF_BUFFERS];
+	GLsync fences[NR_OF_BUFFERS];
+	unsigned current;
+	GLuint binding;
+	GLuint value;
+
+public:
+	AtomicCounter(GLuint binding = 0){
+		this->current = 0;
+		this->binding = binding;
+		this->value = 0;
+
+		GLuint zero = 0;
+		glGenBuffers(NR_OF_BUFFERS, this->buffers);
+		for(unsigned i = 0; i < NR_OF_BUFFERS; i++){
+			glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, this->buffers[i]);
+			glBufferData(GL_ATOMIC_COUNTER_BUFFER, sizeof(GLuint), &zero, GL_DYNAMIC_READ);
+			this->fences[i] = 0;
+		}
+		glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, 0);
+	}
+
+	~AtomicCounter(){
+		for(unsigned i = 0; i < NR_OF_BUFFERS; i++){
+			if(this->fences[i]){
+				glDeleteSync(this->fences[i]);
+			}
+		}
+		glDeleteBuffers(NR_OF_BUFFERS, this->buffers);
+	}
+
+	//Accessors
+	inline GLuint getValue() const{return this->value;}
+
+	//Functions
+
+	// Read the counts of all finished frames, oldest first, so the newest one ends up in value
+	void update(){
+		for(unsigned i = 0; i < NR_OF_BUFFERS; i++){
+			unsigned index = (this->current + i) % NR_OF_BUFFERS;
+			GLsync& fence = this->fences[index];
+			if(!fence){
+				continue;
+			}
+			GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+			if(result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED){
+				glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, this->buffers[index]);
+				glGetBufferSubData(GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(GLuint), &this->value);
+				glDeleteSync(fence);
+				fence = 0;
+			}
+		}
+		glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, 0);
+	}
+
+	// Collect finished counts, then reset the next buffer and bind it for the new frame
+	void begin(){
+		this->update();
+
+		// The frame is several frames old, its count is dropped rather than waited for
+		GLsync& fence = this->fences[this->current];
+		if(fence){
+			glDeleteSync(fence);
+			fence = 0;
+		}
+
+		GLuint buffer = this->buffers[this->current];
+		glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, buffer);
+		GLuint zero = 0;
+		glBufferSubData(GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(GLuint), &zero);
+		glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, this->binding, buffer);
+		glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, 0);
+	}
+
+	// Call after the last draw that counts this frame
+	void end(){
+		this->fences[this->current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		this->current = (this->current + 1) % NR_OF_BUFFERS;
+	}
+};
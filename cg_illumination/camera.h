@@ -8,6 +8,8 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "frustum.h"
+
 
 
 // Defines several possible options for camera movement. Used as abstraction to stay away from window-system specific input methods
@@ -108,6 +110,11 @@ public:
 		return glm::perspective(glm::radians(this->zoom), width / height, 0.1f, 10000.0f);
 	}
 
+	// World space planes of the current view
+	const Frustum getFrustum(GLfloat width, GLfloat height){
+		return Frustum(this->getProjectionMatrix(width, height) * this->getViewMatrix());
+	}
+
     // Processes input received from any keyboard-like input system. Accepts input parameter in the form of camera defined ENUM (to abstract it from windowing systems)
     void Move(direction direction, GLfloat dt)
     {
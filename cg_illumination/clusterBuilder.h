@@ -0,0 +1,204 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <tuple>
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <cmath>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "vertex.h"
+
+// Contiguous range of triangles in the index buffer of a mesh with its bounds in model space.
+// cone.xyz is the average normal and cone.w the sine of the largest angle between it and a triangle normal, 1 if the
+// normals spread over more than a half space. The cluster faces away from a camera at p if
+// dot(center - p, axis) >= cone.w * length(center - p) + radius.
+struct Cluster{
+	GLuint firstIndex;
+	GLuint nrOfIndices;
+	glm::vec4 sphere;
+	glm::vec4 cone;
+};
+
+// Splits triangle meshes into clusters of up to maxTriangles triangles that can be culled on their own.
+// Clusters grow over shared vertices from a seed, taking the candidate closest to the cluster's center and normal
+// next, so they come out compact and flat. Seeds follow a Morton order of the triangle centers, which keeps the
+// last clusters of a region from being scattered leftovers.
+class ClusterBuilder{
+private:
+	static GLuint spreadBits(GLuint x){
+		x &= 0x3FF;
+		x = (x | (x << 16)) & 0x030000FF;
+		x = (x | (x << 8)) & 0x0300F00F;
+		x = (x | (x << 4)) & 0x030C30C3;
+		x = (x | (x << 2)) & 0x09249249;
+		return x;
+	}
+
+	static void computeBounds(const Vertex* vertices, const GLuint* indices, const std::vector<glm::vec3>& normals,
+		const std::vector<GLuint>& triangles, Cluster& cluster){
+		glm::vec3 minimum = vertices[indices[triangles[0] * 3]].position;
+		glm::vec3 maximum = minimum;
+		glm::vec3 axis(0.f);
+		for(GLuint t : triangles){
+			for(int i = 0; i < 3; i++){
+				minimum = glm::min(minimum, vertices[indices[t * 3 + i]].position);
+				maximum = glm::max(maximum, vertices[indices[t * 3 + i]].position);
+			}
+			// Unnormalized, so large triangles weigh more
+			axis += normals[t];
+		}
+		glm::vec3 center = (minimum + maximum) * 0.5f;
+		GLfloat radius = 0.f;
+		for(GLuint t : triangles){
+			for(int i = 0; i < 3; i++){
+				radius = std::max(radius, glm::length(vertices[indices[t * 3 + i]].position - center));
+			}
+		}
+		cluster.sphere = glm::vec4(center, radius);
+
+		GLfloat length = glm::length(axis);
+		GLfloat minimumDot = -1.f;
+		if(length > 0.f){
+			axis /= length;
+			minimumDot = 1.f;
+			for(GLuint t : triangles){
+				GLfloat area = glm::length(normals[t]);
+				if(area > 0.f){
+					minimumDot = std::min(minimumDot, glm::dot(axis, normals[t] / area));
+				}
+			}
+		}
+		// Cones wider than a half space (or nearly) never cull
+		GLfloat cutoff = minimumDot <= 0.1f ? 1.f : std::sqrt(1.f - minimumDot * minimumDot);
+		cluster.cone = glm::vec4(axis, cutoff);
+	}
+
+public:
+	// Reorders the triangles of indices (nrOfIndices / 3 triangles) so every cluster is one range and returns the
+	// clusters. Vertices at the same position count as shared, so unindexed triangle lists work too.
+	static std::vector<Cluster> build(const Vertex* vertices, GLuint* indices, size_t nrOfIndices, size_t maxTriangles = 128){
+		std::vector<Cluster> clusters;
+		size_t nrOfTriangles = nrOfIndices / 3;
+		if(nrOfTriangles == 0){
+			return clusters;
+		}
+
+		// Triangles around every welded position
+		std::map<std::tuple<GLfloat, GLfloat, GLfloat>, GLuint> welded;
+		std::vector<GLuint> corners(nrOfTriangles * 3);
+		for(size_t i = 0; i < nrOfTriangles * 3; i++){
+			const glm::vec3& p = vertices[indices[i]].position;
+			auto it = welded.insert(std::make_pair(std::make_tuple(p.x, p.y, p.z), (GLuint)welded.size())).first;
+			corners[i] = it->second;
+		}
+		std::vector<std::vector<GLuint>> positionTriangles(welded.size());
+		for(size_t i = 0; i < nrOfTriangles * 3; i++){
+			positionTriangles[corners[i]].push_back((GLuint)(i / 3));
+		}
+
+		std::vector<glm::vec3> centers(nrOfTriangles);
+		std::vector<glm::vec3> normals(nrOfTriangles);
+		glm::vec3 minimum = vertices[indices[0]].position;
+		glm::vec3 maximum = minimum;
+		for(size_t t = 0; t < nrOfTriangles; t++){
+			glm::vec3 a = vertices[indices[t * 3]].position;
+			glm::vec3 b = vertices[indices[t * 3 + 1]].position;
+			glm::vec3 c = vertices[indices[t * 3 + 2]].position;
+			centers[t] = (a + b + c) / 3.f;
+			normals[t] = glm::cross(b - a, c - a) * 0.5f;
+			minimum = glm::min(minimum, glm::min(a, glm::min(b, c)));
+			maximum = glm::max(maximum, glm::max(a, glm::max(b, c)));
+		}
+
+		std::vector<GLuint> seeds(nrOfTriangles);
+		std::vector<GLuint> codes(nrOfTriangles);
+		glm::vec3 extent = glm::max(maximum - minimum, glm::vec3(1e-20f));
+		for(size_t t = 0; t < nrOfTriangles; t++){
+			glm::vec3 cell = (centers[t] - minimum) / extent * 1023.f;
+			codes[t] = spreadBits((GLuint)cell.x) | (spreadBits((GLuint)cell.y) << 1) | (spreadBits((GLuint)cell.z) << 2);
+		}
+		std::iota(seeds.begin(), seeds.end(), 0);
+		std::sort(seeds.begin(), seeds.end(), [&codes](GLuint a, GLuint b){return codes[a] < codes[b];});
+
+		// Typical edge length, distances are scored in these units against normal deviation
+		GLfloat totalArea = 0.f;
+		for(auto& i : normals){
+			totalArea += glm::length(i);
+		}
+		GLfloat scale = std::max(std::sqrt(totalArea / nrOfTriangles), 1e-20f);
+
+		std::vector<bool> assigned(nrOfTriangles, false);
+		std::vector<GLuint> candidateStamp(nrOfTriangles, 0);
+		std::vector<GLuint> reordered;
+		reordered.reserve(nrOfTriangles * 3);
+		std::vector<GLuint> triangles;
+		std::vector<GLuint> candidates;
+		GLuint stamp = 0;
+		for(GLuint seed : seeds){
+			if(assigned[seed]){
+				continue;
+			}
+			stamp++;
+			triangles.clear();
+			candidates.assign(1, seed);
+			candidateStamp[seed] = stamp;
+			glm::vec3 centerSum(0.f);
+			glm::vec3 normalSum(0.f);
+
+			while(triangles.size() < maxTriangles && !candidates.empty()){
+				// Closest to the cluster in position and orientation
+				size_t best = 0;
+				if(!triangles.empty()){
+					glm::vec3 center = centerSum / (GLfloat)triangles.size();
+					GLfloat normalLength = glm::length(normalSum);
+					glm::vec3 normal = normalLength > 0.f ? normalSum / normalLength : glm::vec3(0.f);
+					GLfloat bestScore = std::numeric_limits<GLfloat>::max();
+					for(size_t i = 0; i < candidates.size(); i++){
+						GLuint t = candidates[i];
+						GLfloat area = glm::length(normals[t]);
+						GLfloat deviation = area > 0.f ? 1.f - glm::dot(normal, normals[t] / area) : 0.f;
+						GLfloat score = glm::length(centers[t] - center) / scale + 8.f * deviation;
+						if(score < bestScore){
+							bestScore = score;
+							best = i;
+						}
+					}
+				}
+				GLuint t = candidates[best];
+				candidates[best] = candidates.back();
+				candidates.pop_back();
+
+				assigned[t] = true;
+				triangles.push_back(t);
+				centerSum += centers[t];
+				normalSum += normals[t];
+				for(int i = 0; i < 3; i++){
+					for(GLuint n : positionTriangles[corners[t * 3 + i]]){
+						if(!assigned[n] && candidateStamp[n] != stamp){
+							candidateStamp[n] = stamp;
+							candidates.push_back(n);
+						}
+					}
+				}
+			}
+
+			Cluster cluster;
+			cluster.firstIndex = (GLuint)reordered.size();
+			cluster.nrOfIndices = (GLuint)triangles.size() * 3;
+			computeBounds(vertices, indices, normals, triangles, cluster);
+			for(GLuint i : triangles){
+				reordered.insert(reordered.end(), indices + i * 3, indices + i * 3 + 3);
+			}
+			clusters.push_back(cluster);
+		}
+
+		std::copy(reordered.begin(), reordered.end(), indices);
+		return clusters;
+	}
+};
@@ -0,0 +1,239 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "mesh.h"
+#include "material.h"
+#include "texture.h"
+#include "frustum.h"
+#include "drawBatcher.h"
+
+// Culls the clusters of heap meshes (see Mesh::buildClusters) before they reach a DrawBatcher.
+// Every cluster is tested against the view frustum and its normal cone, both in the model space of its mesh, on a
+// pool of worker threads. Runs of visible clusters that follow each other in the index buffer become one indirect
+// draw, so a mesh that is entirely visible still costs a single command. Meshes without clusters are passed on whole.
+class ClusterCuller{
+private:
+	struct Entry{
+		Mesh* mesh;
+		Material* material;
+		Texture* diffuse;
+		Texture* specular;
+		glm::mat4 model;
+		Frustum frustum;
+		glm::vec3 camera;
+		size_t firstCluster;                       // Offset of the mesh's clusters in visible
+	};
+
+	// Clusters first to last - 1 of one entry
+	struct Job{
+		size_t entry;
+		size_t first;
+		size_t last;
+	};
+
+	static const size_t JOB_SIZE = 256;
+	static const size_t MIN_PARALLEL_CLUSTERS = 2048;
+
+	std::vector<Entry> entries;
+	std::vector<Job> jobs;
+	std::vector<unsigned char> visible;
+	std::atomic<size_t> nextJob;
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::condition_variable finished;
+	unsigned generation;
+	unsigned busy;
+	bool running;
+
+	size_t nrOfClusters;
+	std::atomic<size_t> nrOfOutside;
+	std::atomic<size_t> nrOfBackFacing;
+	size_t nrOfDraws;
+
+	void cull(const Job& job){
+		const Entry& entry = this->entries[job.entry];
+		const std::vector<Cluster>& clusters = entry.mesh->getClusters();
+		size_t outside = 0;
+		size_t backFacing = 0;
+		for(size_t i = job.first; i < job.last; i++){
+			const Cluster& cluster = clusters[i];
+			glm::vec3 center(cluster.sphere);
+			unsigned char& result = this->visible[entry.firstCluster + i];
+			result = 0;
+			if(!entry.frustum.containsSphere(center, cluster.sphere.w)){
+				outside++;
+				continue;
+			}
+			glm::vec3 direction = center - entry.camera;
+			if(glm::dot(direction, glm::vec3(cluster.cone)) >= cluster.cone.w * glm::length(direction) + cluster.sphere.w){
+				backFacing++;
+				continue;
+			}
+			result = 1;
+		}
+		this->nrOfOutside += outside;
+		this->nrOfBackFacing += backFacing;
+	}
+
+	void runJobs(){
+		for(size_t i = this->nextJob++; i < this->jobs.size(); i = this->nextJob++){
+			this->cull(this->jobs[i]);
+		}
+	}
+
+	void addDraw(DrawBatcher* batcher, const Entry& entry, const DrawElementsIndirectCommand& command){
+		if(entry.material->getTextureArray()){
+			batcher->add(entry.material, command, entry.model);
+		}else{
+			batcher->add(entry.material, entry.diffuse, entry.specular, command, entry.model);
+		}
+		this->nrOfDraws++;
+	}
+
+	void work(){
+		unsigned seen = 0;
+		while(true){
+			{
+				std::unique_lock<std::mutex> lock(this->mutex);
+				this->condition.wait(lock, [this, seen](){return !this->running || this->generation != seen;});
+				if(!this->running){
+					return;
+				}
+				seen = this->generation;
+			}
+
+			this->runJobs();
+
+			std::lock_guard<std::mutex> lock(this->mutex);
+			if(--this->busy == 0){
+				this->finished.notify_one();
+			}
+		}
+	}
+
+public:
+	ClusterCuller(unsigned nrOfThreads = 0){
+		this->generation = 0;
+		this->busy = 0;
+		this->running = true;
+		this->nrOfClusters = 0;
+		this->nrOfOutside = 0;
+		this->nrOfBackFacing = 0;
+		this->nrOfDraws = 0;
+
+		// The render thread takes part in every pass, so start one worker less than there are cores
+		if(nrOfThreads == 0){
+			nrOfThreads = std::max(1u, std::thread::hardware_concurrency());
+		}
+		for(unsigned i = 1; i < nrOfThreads; i++){
+			this->workers.push_back(std::thread(&ClusterCuller::work, this));
+		}
+	}
+
+	~ClusterCuller(){
+		{
+			std::lock_guard<std::mutex> lock(this->mutex);
+			this->running = false;
+		}
+		this->condition.notify_all();
+		for(auto& i : this->workers){
+			i.join();
+		}
+	}
+
+	//Accessors
+	inline size_t getNrOfClusters() const{return this->nrOfClusters;}
+	inline size_t getNrOfVisible() const{return this->nrOfClusters - this->nrOfOutside - this->nrOfBackFacing;}
+	inline size_t getNrOfOutside() const{return this->nrOfOutside;}
+	inline size_t getNrOfBackFacing() const{return this->nrOfBackFacing;}
+	inline size_t getNrOfDraws() const{return this->nrOfDraws;}
+
+	//Functions
+
+	// Start a new frame
+	void begin(){
+		this->entries.clear();
+	}
+
+	void add(Mesh* mesh, Material* material, Texture* diffuse, Texture* specular){
+		Entry entry;
+		entry.mesh = mesh;
+		entry.material = material;
+		entry.diffuse = diffuse;
+		entry.specular = specular;
+		entry.model = mesh->getModelMatrix();
+		entry.firstCluster = 0;
+		this->entries.push_back(entry);
+	}
+
+	// Cull all clusters added this frame and add the draws of the visible ones to batcher
+	void flush(DrawBatcher* batcher, const glm::mat4& viewProjection, const glm::vec3& cameraPosition){
+		this->jobs.clear();
+		this->nrOfClusters = 0;
+		this->nrOfOutside = 0;
+		this->nrOfBackFacing = 0;
+		this->nrOfDraws = 0;
+		for(size_t i = 0; i < this->entries.size(); i++){
+			Entry& entry = this->entries[i];
+			entry.frustum = Frustum(viewProjection * entry.model);
+			entry.camera = glm::vec3(glm::inverse(entry.model) * glm::vec4(cameraPosition, 1.f));
+			entry.firstCluster = this->nrOfClusters;
+
+			size_t count = entry.mesh->getClusters().size();
+			for(size_t first = 0; first < count; first += JOB_SIZE){
+				Job job = {i, first, std::min(first + JOB_SIZE, count)};
+				this->jobs.push_back(job);
+			}
+			this->nrOfClusters += count;
+		}
+		this->visible.resize(this->nrOfClusters);
+
+		// Waking the workers costs more than culling a few clusters
+		this->nextJob = 0;
+		if(this->workers.empty() || this->nrOfClusters < MIN_PARALLEL_CLUSTERS){
+			this->runJobs();
+		}else{
+			{
+				std::lock_guard<std::mutex> lock(this->mutex);
+				this->generation++;
+				this->busy = (unsigned)this->workers.size();
+			}
+			this->condition.notify_all();
+			this->runJobs();
+			std::unique_lock<std::mutex> lock(this->mutex);
+			this->finished.wait(lock, [this](){return this->busy == 0;});
+		}
+
+		for(auto& entry : this->entries){
+			size_t count = entry.mesh->getClusters().size();
+			if(count == 0){
+				this->addDraw(batcher, entry, entry.mesh->getDrawCommand());
+				continue;
+			}
+			const unsigned char* flags = &this->visible[entry.firstCluster];
+			for(size_t first = 0; first < count;){
+				if(!flags[first]){
+					first++;
+					continue;
+				}
+				size_t last = first + 1;
+				while(last < count && flags[last]){
+					last++;
+				}
+				this->addDraw(batcher, entry, entry.mesh->getClusterDrawCommand(first, last - first));
+				first = last;
+			}
+		}
+	}
+};
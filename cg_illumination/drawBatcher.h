@@ -0,0 +1,191 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "geometryHeap.h"
+#include "transformBatch.h"
+#include "streamBuffer.h"
+#include "shader.h"
+#include "material.h"
+#include "texture.h"
+#include "textureArray.h"
+
+// Material of one draw as main.frag_array.glsl reads it, std430 compatible.
+// The w components hold the diffuse and specular layer in the texture array.
+struct DrawMaterial{
+	glm::vec4 ambient;
+	glm::vec4 diffuse;
+	glm::vec4 specular;
+};
+
+// Collects the draws of all heap meshes for one frame and submits every group of draws
+// sharing material and textures with a single glMultiDrawElementsIndirect call.
+// The per-draw matrices go to an SSBO that the vertex shader indexes with gl_DrawID.
+// Materials whose textures live in a texture array are batched by the array alone, their colors and layers
+// go to a second SSBO, so objects with different materials and textures still share one multi draw.
+class DrawBatcher{
+private:
+	struct Batch{
+		Material* material;
+		Texture* diffuse;
+		Texture* specular;
+		TextureArray* array;
+		std::vector<DrawElementsIndirectCommand> commands;
+		std::vector<glm::mat4> transforms;
+		std::vector<DrawMaterial> materials;
+	};
+
+	GeometryHeap* heap;
+	StreamBuffer* stream;
+	std::vector<Batch> batches;
+
+	GLuint transformBinding;
+	GLuint materialBinding;
+
+	std::vector<DrawElementsIndirectCommand> frameCommands;
+	std::vector<glm::mat4> frameModels;
+	std::vector<DrawTransform> frameTransforms;
+	std::vector<DrawMaterial> frameMaterials;
+
+	Batch& findBatch(Material* material, Texture* diffuse, Texture* specular, TextureArray* array){
+		for(auto& i : this->batches){
+			if(i.material == material && i.diffuse == diffuse && i.specular == specular && i.array == array){
+				return i;
+			}
+		}
+		Batch batch;
+		batch.material = material;
+		batch.diffuse = diffuse;
+		batch.specular = specular;
+		batch.array = array;
+		this->batches.push_back(batch);
+		return this->batches.back();
+	}
+
+	static DrawMaterial makeDrawMaterial(const Material* material){
+		DrawMaterial drawMaterial;
+		drawMaterial.ambient = glm::vec4(material->getAmbient(), 0.f);
+		drawMaterial.diffuse = glm::vec4(material->getDiffuse(), (GLfloat)material->getDiffuseLayer());
+		drawMaterial.specular = glm::vec4(material->getSpecular(), (GLfloat)material->getSpecularLayer());
+		return drawMaterial;
+	}
+
+public:
+	DrawBatcher(GeometryHeap* heap, StreamBuffer* stream, GLuint transformBinding = 0, GLuint materialBinding = 2){
+		this->heap = heap;
+		this->stream = stream;
+		this->transformBinding = transformBinding;
+		this->materialBinding = materialBinding;
+	}
+
+	~DrawBatcher(){}
+
+	//Accessors
+	inline size_t getNrOfBatches() const{return this->batches.size();}
+
+	//Functions
+
+	// Start a new frame, batches are kept so their vectors keep their capacity
+	void begin(){
+		for(auto& i : this->batches){
+			i.commands.clear();
+			i.transforms.clear();
+			i.materials.clear();
+		}
+	}
+
+	void add(Material* material, Texture* diffuse, Texture* specular, const DrawElementsIndirectCommand& command, const glm::mat4& model){
+		Batch& batch = this->findBatch(material, diffuse, specular, nullptr);
+		batch.commands.push_back(command);
+		batch.transforms.push_back(model);
+		batch.materials.push_back(makeDrawMaterial(material));
+	}
+
+	// Draw of a material that references layers of a texture array
+	void add(Material* material, const DrawElementsIndirectCommand& command, const glm::mat4& model){
+		Batch& batch = this->findBatch(nullptr, nullptr, nullptr, material->getTextureArray());
+		batch.commands.push_back(command);
+		batch.transforms.push_back(model);
+		batch.materials.push_back(makeDrawMaterial(material));
+	}
+
+	// Upload all commands, transforms and materials of the frame at once, then issue one multi draw per batch.
+	// Texture array batches need arrayShader (main.frag_array.glsl), shader samples 2D textures at the same units.
+	void flush(Shader* shader, const glm::mat4& viewProjection, GLenum mode = GL_TRIANGLES, Shader* arrayShader = nullptr){
+		this->frameCommands.clear();
+		this->frameModels.clear();
+		this->frameMaterials.clear();
+		for(auto& i : this->batches){
+			this->frameCommands.insert(this->frameCommands.end(), i.commands.begin(), i.commands.end());
+			this->frameModels.insert(this->frameModels.end(), i.transforms.begin(), i.transforms.end());
+			this->frameMaterials.insert(this->frameMaterials.end(), i.materials.begin(), i.materials.end());
+		}
+		if(this->frameCommands.empty()){
+			return;
+		}
+
+		// Model-view-projection and normal matrices for every draw, so shaders don't multiply per vertex
+		computeDrawTransforms(viewProjection, this->frameModels, this->frameTransforms);
+
+		// Write both arrays straight into the persistently mapped stream buffer
+		StreamAllocation commands = this->stream->upload(this->frameCommands.data(),
+			this->frameCommands.size() * sizeof(DrawElementsIndirectCommand), sizeof(DrawElementsIndirectCommand));
+		StreamAllocation transforms = this->stream->upload(this->frameTransforms.data(),
+			this->frameTransforms.size() * sizeof(DrawTransform), this->stream->getStorageAlignment());
+		StreamAllocation materials = this->stream->upload(this->frameMaterials.data(),
+			this->frameMaterials.size() * sizeof(DrawMaterial), this->stream->getStorageAlignment());
+		if(!commands.data || !transforms.data || !materials.data){
+			return;
+		}
+
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, this->stream->getBuffer());
+		this->stream->bindRange(GL_SHADER_STORAGE_BUFFER, this->transformBinding, transforms);
+		this->stream->bindRange(GL_SHADER_STORAGE_BUFFER, this->materialBinding, materials);
+
+		GLint drawOffset = 0;
+		for(auto& i : this->batches){
+			if(i.commands.empty()){
+				continue;
+			}
+
+			Shader* program = shader;
+			if(i.array){
+				if(!arrayShader){
+					std::cout << "ERROR::DRAWBATCHER::NO_ARRAY_SHADER: " << i.commands.size() << " draws skipped" << "\n";
+					drawOffset += (GLint)i.commands.size();
+					continue;
+				}
+				//Colors and layers come from the material buffer, one bind covers every texture of the batch
+				program = arrayShader;
+				program->set1i(drawOffset, "drawOffset");
+				program->set1i(0, "textures");
+				i.array->bind(0);
+			}else{
+				//Update uniforms
+				i.material->sendToShader(*program);
+				program->set1i(drawOffset, "drawOffset");
+
+				//Activate texture
+				i.diffuse->bind(0);
+				i.specular->bind(1);
+			}
+
+			//Draw
+			program->Use();
+			this->heap->bind();
+			glMultiDrawElementsIndirect(mode, GL_UNSIGNED_INT, (GLvoid*)(commands.offset + drawOffset * sizeof(DrawElementsIndirectCommand)), (GLsizei)i.commands.size(), 0);
+
+			drawOffset += (GLint)i.commands.size();
+		}
+
+		//Cleanup
+		this->heap->unbind();
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		glUseProgram(0);
+	}
+};
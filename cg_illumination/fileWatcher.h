@@ -0,0 +1,155 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <chrono>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+// Reports files that were written since the last poll().
+// On Linux the directories of the files are watched with inotify, which also sees editors that save by
+// writing a new file and renaming it over the old one. Elsewhere, or if inotify is not available, the
+// modification times are compared with stat() at most every pollInterval seconds.
+class FileWatcher{
+private:
+	std::vector<std::string> files;
+	std::map<std::string, time_t> modified;
+	double pollInterval;
+	std::chrono::steady_clock::time_point lastPoll;
+
+#ifdef __linux__
+	int fd;
+	std::map<int, std::string> directories;    // Watch descriptor to directory prefix of the watched files
+#endif
+
+	static time_t modificationTime(const std::string& path){
+		struct stat status;
+		if(stat(path.c_str(), &status) != 0){
+			return 0;
+		}
+		return status.st_mtime;
+	}
+
+	static std::string directoryOf(const std::string& path){
+		return path.substr(0, path.find_last_of("/\\") + 1);
+	}
+
+	void pollTimes(std::vector<std::string>& changed){
+		auto now = std::chrono::steady_clock::now();
+		if(std::chrono::duration<double>(now - this->lastPoll).count() < this->pollInterval){
+			return;
+		}
+		this->lastPoll = now;
+		for(auto& i : this->files){
+			time_t time = modificationTime(i);
+			// A missing file is in the middle of being replaced, wait until it is back
+			if(time != 0 && time != this->modified[i]){
+				this->modified[i] = time;
+				changed.push_back(i);
+			}
+		}
+	}
+
+#ifdef __linux__
+	void readEvents(std::vector<std::string>& changed){
+		alignas(struct inotify_event) char buffer[4096];
+		while(true){
+			ssize_t length = read(this->fd, buffer, sizeof(buffer));
+			if(length <= 0){
+				if(length < 0 && errno != EAGAIN){
+					std::cout << "ERROR::FILEWATCHER::READ_FAILED: " << errno << "\n";
+				}
+				return;
+			}
+			for(char* i = buffer; i < buffer + length;){
+				struct inotify_event* event = (struct inotify_event*)i;
+				i += sizeof(struct inotify_event) + event->len;
+				auto directory = this->directories.find(event->wd);
+				if(event->len == 0 || directory == this->directories.end()){
+					continue;
+				}
+				std::string path = directory->second + event->name;
+				if(std::find(this->files.begin(), this->files.end(), path) != this->files.end() &&
+					std::find(changed.begin(), changed.end(), path) == changed.end()){
+					changed.push_back(path);
+				}
+			}
+		}
+	}
+#endif
+
+public:
+	FileWatcher(double pollInterval = 0.5){
+		this->pollInterval = pollInterval;
+		this->lastPoll = std::chrono::steady_clock::now();
+#ifdef __linux__
+		this->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if(this->fd < 0){
+			std::cout << "ERROR::FILEWATCHER::INOTIFY_UNAVAILABLE: polling every " << pollInterval << "s" << "\n";
+		}
+#endif
+	}
+
+	~FileWatcher(){
+#ifdef __linux__
+		if(this->fd >= 0){
+			close(this->fd);
+		}
+#endif
+	}
+
+	//Accessors
+	inline size_t getNrOfFiles() const{return this->files.size();}
+
+	//Functions
+
+	// Paths are matched as given, so use the same spelling the files are opened with
+	void add(const std::string& path){
+		if(std::find(this->files.begin(), this->files.end(), path) != this->files.end()){
+			return;
+		}
+		this->files.push_back(path);
+		this->modified[path] = modificationTime(path);
+
+#ifdef __linux__
+		if(this->fd < 0){
+			return;
+		}
+		std::string directory = directoryOf(path);
+		for(auto& i : this->directories){
+			if(i.second == directory){
+				return;
+			}
+		}
+		int wd = inotify_add_watch(this->fd, directory.empty() ? "." : directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+		if(wd < 0){
+			std::cout << "ERROR::FILEWATCHER::COULD_NOT_WATCH: " << directory << "\n";
+			return;
+		}
+		this->directories[wd] = directory;
+#endif
+	}
+
+	// Files written since the last call, each listed once
+	std::vector<std::string> poll(){
+		std::vector<std::string> changed;
+#ifdef __linux__
+		if(this->fd >= 0){
+			this->readEvents(changed);
+			return changed;
+		}
+#endif
+		this->pollTimes(changed);
+		return changed;
+	}
+};
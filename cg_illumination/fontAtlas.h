@@ -0,0 +1,496 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+// FreeType
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include "hash.h"
+
+// Signed distance field glyph atlas for a set of unicode code points (ASCII and Latin-1 by default).
+// Glyphs are rendered by FreeType at SUPERSAMPLE times the atlas size, converted to distance fields with an
+// exact euclidean distance transform on all cores and shelf packed into one single channel image.
+// The result, including kerning pairs, is cached on disk keyed by a hash of the font file, the pixel size and
+// the code points, so warm runs never touch FreeType.
+class FontAtlas{
+public:
+	struct Glyph{
+		glm::vec4 uv;          // Rectangle of the glyph in the atlas (u0, v0, u1, v1)
+		glm::ivec2 size;       // Size of the quad in atlas pixels, including the distance spread
+		glm::ivec2 bearing;    // Offset from baseline to left/top of the quad
+		GLuint advance;        // Horizontal offset to the next glyph in 1/64 pixels
+	};
+
+	// Positioned glyph as produced by layout, rect is (x0, y0, x1, y1) with y pointing up
+	struct GlyphQuad{
+		glm::vec4 rect;
+		glm::vec4 uv;
+	};
+
+	static const int SPREAD = 6;       // Distance in atlas pixels covered by the field on each side of the outline
+	static const int SUPERSAMPLE = 4;
+
+private:
+	static const int ATLAS_WIDTH = 1024;
+	static const unsigned CACHE_VERSION = 2;
+
+	struct GlyphBitmap{
+		int width;
+		int rows;
+		std::vector<unsigned char> pixels;
+	};
+
+	int pixelSize;
+	std::vector<unsigned> codepoints;
+	std::vector<Glyph> glyphs;
+	int asciiGlyphs[128];
+	std::unordered_map<unsigned, int> glyphIndices;
+	std::unordered_map<unsigned long long, int> kerning;
+	GLfloat lineHeight;
+	glm::ivec2 size;
+	std::vector<unsigned char> image;
+
+	static unsigned long long kerningKey(unsigned left, unsigned right){
+		return ((unsigned long long)left << 32) | right;
+	}
+
+	void buildLookup(){
+		for(int c = 0; c < 128; c++){
+			this->asciiGlyphs[c] = -1;
+		}
+		this->glyphIndices.clear();
+		for(size_t i = 0; i < this->codepoints.size(); i++){
+			if(this->codepoints[i] < 128){
+				this->asciiGlyphs[this->codepoints[i]] = (int)i;
+			}
+			this->glyphIndices[this->codepoints[i]] = (int)i;
+		}
+	}
+
+	// 1D squared distance transform of Felzenszwalb and Huttenlocher
+	static void distanceTransform1D(const float* f, float* d, int n, int* v, float* z){
+		int k = 0;
+		v[0] = 0;
+		z[0] = -1e20f;
+		z[1] = 1e20f;
+		for(int q = 1; q < n; q++){
+			float s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2 * q - 2 * v[k]);
+			while(s <= z[k]){
+				k--;
+				s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2 * q - 2 * v[k]);
+			}
+			k++;
+			v[k] = q;
+			z[k] = s;
+			z[k + 1] = 1e20f;
+		}
+		k = 0;
+		for(int q = 0; q < n; q++){
+			while(z[k + 1] < q){
+				k++;
+			}
+			d[q] = (q - v[k]) * (q - v[k]) + f[v[k]];
+		}
+	}
+
+	// Squared distance of every pixel to the nearest pixel where seed is true
+	static std::vector<float> distanceTransform(const std::vector<bool>& seed, int width, int height){
+		int n = std::max(width, height);
+		std::vector<float> grid(width * height);
+		std::vector<float> f(n), d(n), z(n + 1);
+		std::vector<int> v(n);
+		for(int i = 0; i < width * height; i++){
+			grid[i] = seed[i] ? 0.f : 1e20f;
+		}
+		for(int x = 0; x < width; x++){
+			for(int y = 0; y < height; y++){
+				f[y] = grid[y * width + x];
+			}
+			distanceTransform1D(f.data(), d.data(), height, v.data(), z.data());
+			for(int y = 0; y < height; y++){
+				grid[y * width + x] = d[y];
+			}
+		}
+		for(int y = 0; y < height; y++){
+			distanceTransform1D(&grid[y * width], d.data(), width, v.data(), z.data());
+			std::memcpy(&grid[y * width], d.data(), width * sizeof(float));
+		}
+		return grid;
+	}
+
+	// Turns a supersampled coverage bitmap into a distance field at atlas resolution
+	static GlyphBitmap buildDistanceField(const unsigned char* coverage, int width, int rows, int pitch){
+		const int pad = SPREAD * SUPERSAMPLE;
+		int hiWidth = width + 2 * pad;
+		int hiRows = rows + 2 * pad;
+		std::vector<bool> inside(hiWidth * hiRows, false);
+		std::vector<bool> outside(hiWidth * hiRows, true);
+		for(int y = 0; y < rows; y++){
+			for(int x = 0; x < width; x++){
+				bool in = coverage[y * pitch + x] >= 128;
+				inside[(y + pad) * hiWidth + x + pad] = in;
+				outside[(y + pad) * hiWidth + x + pad] = !in;
+			}
+		}
+		std::vector<float> toInside = distanceTransform(inside, hiWidth, hiRows);
+		std::vector<float> toOutside = distanceTransform(outside, hiWidth, hiRows);
+
+		GlyphBitmap field;
+		field.width = (width + SUPERSAMPLE - 1) / SUPERSAMPLE + 2 * SPREAD;
+		field.rows = (rows + SUPERSAMPLE - 1) / SUPERSAMPLE + 2 * SPREAD;
+		field.pixels.resize(field.width * field.rows);
+		for(int y = 0; y < field.rows; y++){
+			for(int x = 0; x < field.width; x++){
+				int hx = std::min(x * SUPERSAMPLE + SUPERSAMPLE / 2, hiWidth - 1);
+				int hy = std::min(y * SUPERSAMPLE + SUPERSAMPLE / 2, hiRows - 1);
+				// Positive inside the glyph, in atlas pixels
+				float distance = (std::sqrt(toOutside[hy * hiWidth + hx]) - std::sqrt(toInside[hy * hiWidth + hx])) / SUPERSAMPLE;
+				float value = 0.5f + 0.5f * distance / SPREAD;
+				field.pixels[y * field.width + x] = (unsigned char)(std::min(std::max(value, 0.f), 1.f) * 255.f + 0.5f);
+			}
+		}
+		return field;
+	}
+
+	// Render and convert all glyphs, every thread gets its own FreeType library since faces are not thread safe
+	bool generate(const char* fontPath, std::vector<GlyphBitmap>& bitmaps){
+		std::atomic<int> next(0);
+		std::atomic<bool> failed(false);
+		auto worker = [&](){
+			FT_Library ft;
+			FT_Face face;
+			if(FT_Init_FreeType(&ft)){
+				std::cout << "ERROR::FREETYPE: Could not init FreeType Library" << std::endl;
+				failed = true;
+				return;
+			}
+			if(FT_New_Face(ft, fontPath, 0, &face)){
+				std::cout << "ERROR::FREETYPE: Failed to load font" << std::endl;
+				FT_Done_FreeType(ft);
+				failed = true;
+				return;
+			}
+			FT_Set_Pixel_Sizes(face, 0, this->pixelSize * SUPERSAMPLE);
+
+			for(int c = next++; c < (int)this->codepoints.size(); c = next++){
+				if(FT_Load_Char(face, this->codepoints[c], FT_LOAD_RENDER)){
+					std::cout << "ERROR::FREETYTPE: Failed to load Glyph" << std::endl;
+					continue;
+				}
+				FT_GlyphSlot slot = face->glyph;
+				this->glyphs[c].advance = GLuint(slot->advance.x / SUPERSAMPLE);
+				if(slot->bitmap.width == 0 || slot->bitmap.rows == 0){
+					continue;
+				}
+				bitmaps[c] = buildDistanceField(slot->bitmap.buffer, slot->bitmap.width, slot->bitmap.rows, slot->bitmap.pitch);
+				this->glyphs[c].size = glm::ivec2(bitmaps[c].width, bitmaps[c].rows);
+				this->glyphs[c].bearing = glm::ivec2(
+					(int)std::floor(slot->bitmap_left / (float)SUPERSAMPLE) - SPREAD,
+					(int)std::ceil(slot->bitmap_top / (float)SUPERSAMPLE) + SPREAD);
+			}
+			FT_Done_Face(face);
+			FT_Done_FreeType(ft);
+		};
+
+		unsigned nrOfThreads = std::max(1u, std::thread::hardware_concurrency());
+		std::vector<std::thread> threads;
+		for(unsigned i = 0; i < nrOfThreads; i++){
+			threads.push_back(std::thread(worker));
+		}
+		for(auto& i : threads){
+			i.join();
+		}
+		return !failed;
+	}
+
+	// Line height and kerning of every pair of code points, read once from an unhinted face
+	void generateKerning(const char* fontPath){
+		FT_Library ft;
+		FT_Face face;
+		this->lineHeight = (GLfloat)this->pixelSize;
+		if(FT_Init_FreeType(&ft)){
+			return;
+		}
+		if(FT_New_Face(ft, fontPath, 0, &face)){
+			FT_Done_FreeType(ft);
+			return;
+		}
+		FT_Set_Pixel_Sizes(face, 0, this->pixelSize * SUPERSAMPLE);
+		this->lineHeight = face->size->metrics.height / 64.f / SUPERSAMPLE;
+
+		if(FT_HAS_KERNING(face)){
+			std::vector<FT_UInt> indices(this->codepoints.size());
+			for(size_t i = 0; i < this->codepoints.size(); i++){
+				indices[i] = FT_Get_Char_Index(face, this->codepoints[i]);
+			}
+			for(size_t l = 0; l < indices.size(); l++){
+				for(size_t r = 0; r < indices.size(); r++){
+					FT_Vector delta;
+					if(!FT_Get_Kerning(face, indices[l], indices[r], FT_KERNING_UNFITTED, &delta) && delta.x != 0){
+						this->kerning[kerningKey(this->codepoints[l], this->codepoints[r])] = (int)(delta.x / SUPERSAMPLE);
+					}
+				}
+			}
+		}
+		FT_Done_Face(face);
+		FT_Done_FreeType(ft);
+	}
+
+	// Shelf packing: glyphs are placed left to right in rows as high as the tallest glyph of the row
+	void pack(const std::vector<GlyphBitmap>& bitmaps){
+		std::vector<glm::ivec2> offsets(bitmaps.size());
+		int x = 1;
+		int y = 1;
+		int rowHeight = 0;
+		for(size_t i = 0; i < bitmaps.size(); i++){
+			if(x + bitmaps[i].width + 1 > ATLAS_WIDTH){
+				x = 1;
+				y += rowHeight + 1;
+				rowHeight = 0;
+			}
+			offsets[i] = glm::ivec2(x, y);
+			x += bitmaps[i].width + 1;
+			rowHeight = std::max(rowHeight, bitmaps[i].rows);
+		}
+		this->size = glm::ivec2(ATLAS_WIDTH, y + rowHeight + 1);
+
+		this->image.assign(this->size.x * this->size.y, 0);
+		for(size_t i = 0; i < bitmaps.size(); i++){
+			for(int row = 0; row < bitmaps[i].rows; row++){
+				std::memcpy(&this->image[(offsets[i].y + row) * this->size.x + offsets[i].x],
+					&bitmaps[i].pixels[row * bitmaps[i].width], bitmaps[i].width);
+			}
+			this->glyphs[i].uv = glm::vec4(
+				offsets[i].x / (GLfloat)this->size.x,
+				offsets[i].y / (GLfloat)this->size.y,
+				(offsets[i].x + bitmaps[i].width) / (GLfloat)this->size.x,
+				(offsets[i].y + bitmaps[i].rows) / (GLfloat)this->size.y
+			);
+		}
+	}
+
+	bool loadCache(const std::string& path){
+		std::ifstream in_file(path, std::ios::binary);
+		if(!in_file){
+			return false;
+		}
+		unsigned version = 0;
+		in_file.read((char*)&version, sizeof(version));
+		if(version != CACHE_VERSION){
+			return false;
+		}
+		unsigned nrOfGlyphs = 0;
+		in_file.read((char*)&nrOfGlyphs, sizeof(nrOfGlyphs));
+		if(nrOfGlyphs != this->codepoints.size()){
+			return false;
+		}
+		this->glyphs.resize(nrOfGlyphs);
+		in_file.read((char*)this->glyphs.data(), nrOfGlyphs * sizeof(Glyph));
+		in_file.read((char*)&this->lineHeight, sizeof(this->lineHeight));
+
+		unsigned nrOfPairs = 0;
+		in_file.read((char*)&nrOfPairs, sizeof(nrOfPairs));
+		for(unsigned i = 0; i < nrOfPairs && in_file; i++){
+			unsigned long long key;
+			int value;
+			in_file.read((char*)&key, sizeof(key));
+			in_file.read((char*)&value, sizeof(value));
+			this->kerning[key] = value;
+		}
+
+		in_file.read((char*)&this->size, sizeof(this->size));
+		this->image.resize(this->size.x * this->size.y);
+		in_file.read((char*)this->image.data(), this->image.size());
+		return (bool)in_file;
+	}
+
+	void saveCache(const std::string& path){
+		std::ofstream out_file(path, std::ios::binary);
+		if(!out_file){
+			std::cout << "ERROR::FONTATLAS::COULD_NOT_WRITE_CACHE: " << path << "\n";
+			return;
+		}
+		unsigned version = CACHE_VERSION;
+		unsigned nrOfGlyphs = (unsigned)this->glyphs.size();
+		unsigned nrOfPairs = (unsigned)this->kerning.size();
+		out_file.write((const char*)&version, sizeof(version));
+		out_file.write((const char*)&nrOfGlyphs, sizeof(nrOfGlyphs));
+		out_file.write((const char*)this->glyphs.data(), nrOfGlyphs * sizeof(Glyph));
+		out_file.write((const char*)&this->lineHeight, sizeof(this->lineHeight));
+		out_file.write((const char*)&nrOfPairs, sizeof(nrOfPairs));
+		for(auto& i : this->kerning){
+			out_file.write((const char*)&i.first, sizeof(i.first));
+			out_file.write((const char*)&i.second, sizeof(i.second));
+		}
+		out_file.write((const char*)&this->size, sizeof(this->size));
+		out_file.write((const char*)this->image.data(), this->image.size());
+	}
+
+public:
+	FontAtlas(const char* fontPath, int pixelSize, const std::vector<unsigned>& codepoints = defaultCodepoints()){
+		this->pixelSize = pixelSize;
+		this->codepoints = codepoints;
+		this->lineHeight = (GLfloat)pixelSize;
+		this->buildLookup();
+
+		// Cache file name is derived from the font content and the code points, so a changed font is never served stale
+		unsigned long long hash = Hash::bytes(codepoints.data(), codepoints.size() * sizeof(unsigned), Hash::file(fontPath));
+		std::stringstream cachePath;
+		cachePath << "font_" << std::hex << std::setw(16) << std::setfill('0') << hash
+			<< std::dec << "_" << pixelSize << ".sdf";
+
+		if(this->loadCache(cachePath.str())){
+			return;
+		}
+
+		std::vector<GlyphBitmap> bitmaps(codepoints.size());
+		this->glyphs.resize(codepoints.size());
+		for(size_t c = 0; c < codepoints.size(); c++){
+			bitmaps[c].width = 0;
+			bitmaps[c].rows = 0;
+			this->glyphs[c] = {glm::vec4(0.f), glm::ivec2(0), glm::ivec2(0), 0};
+		}
+		this->kerning.clear();
+		bool generated = this->generate(fontPath, bitmaps);
+		this->generateKerning(fontPath);
+		this->pack(bitmaps);
+		if(generated){
+			this->saveCache(cachePath.str());
+		}
+	}
+
+	~FontAtlas(){}
+
+	// Printable ASCII and Latin-1
+	static std::vector<unsigned> defaultCodepoints(){
+		std::vector<unsigned> codepoints;
+		for(unsigned c = 32; c < 127; c++){
+			codepoints.push_back(c);
+		}
+		for(unsigned c = 160; c < 256; c++){
+			codepoints.push_back(c);
+		}
+		return codepoints;
+	}
+
+	// Decodes UTF-8, invalid bytes become U+FFFD
+	static std::vector<unsigned> decodeUtf8(const std::string& text){
+		std::vector<unsigned> result;
+		for(size_t i = 0; i < text.size();){
+			unsigned char c = text[i];
+			int length = c < 0x80 ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xE ? 3 : (c >> 3) == 0x1E ? 4 : 0;
+			if(length == 0 || i + length > text.size()){
+				result.push_back(0xFFFD);
+				i++;
+				continue;
+			}
+			unsigned codepoint = length == 1 ? c : c & (0xFF >> (length + 1));
+			for(int j = 1; j < length; j++){
+				codepoint = (codepoint << 6) | (text[i + j] & 0x3F);
+			}
+			result.push_back(codepoint);
+			i += length;
+		}
+		return result;
+	}
+
+	//Accessors
+	inline int getPixelSize() const{return this->pixelSize;}
+	inline GLfloat getLineHeight() const{return this->lineHeight;}
+	inline glm::ivec2 getSize() const{return this->size;}
+	inline const unsigned char* getImage() const{return this->image.data();}
+
+	// Missing code points fall back to '?'
+	const Glyph& getGlyph(unsigned codepoint) const{
+		int index = -1;
+		if(codepoint < 128){
+			index = this->asciiGlyphs[codepoint];
+		}else{
+			auto it = this->glyphIndices.find(codepoint);
+			if(it != this->glyphIndices.end()){
+				index = it->second;
+			}
+		}
+		if(index < 0){
+			index = std::max(this->asciiGlyphs['?'], 0);
+		}
+		return this->glyphs[index];
+	}
+
+	// Kerning in 1/64 pixels
+	int getKerning(unsigned left, unsigned right) const{
+		auto it = this->kerning.find(kerningKey(left, right));
+		return it == this->kerning.end() ? 0 : it->second;
+	}
+
+	// Lays out UTF-8 text with its first baseline at (x, y). '\n' starts a new line and if maxWidth is
+	// positive, words that would cross x + maxWidth are moved to the next line.
+	void layout(const std::string& text, GLfloat x, GLfloat y, GLfloat scale, GLfloat maxWidth, std::vector<GlyphQuad>& quads) const{
+		std::vector<unsigned> codepoints = decodeUtf8(text);
+		GLfloat penX = x;
+		GLfloat penY = y;
+		size_t wordStart = quads.size();
+		GLfloat wordStartX = penX;
+		unsigned previous = 0;
+
+		for(unsigned c : codepoints){
+			if(c == '\n'){
+				penX = x;
+				penY -= this->lineHeight * scale;
+				wordStart = quads.size();
+				wordStartX = penX;
+				previous = 0;
+				continue;
+			}
+			if(previous){
+				penX += (this->getKerning(previous, c) / 64.f) * scale;
+			}
+			previous = c;
+			if(c == ' ' || c == '\t'){
+				penX += (this->getGlyph(' ').advance >> 6) * scale * (c == '\t' ? 4 : 1);
+				wordStart = quads.size();
+				wordStartX = penX;
+				continue;
+			}
+
+			const Glyph& ch = this->getGlyph(c);
+			GlyphQuad quad;
+			quad.rect.x = penX + ch.bearing.x * scale;
+			quad.rect.y = penY - (ch.size.y - ch.bearing.y) * scale;
+			quad.rect.z = quad.rect.x + ch.size.x * scale;
+			quad.rect.w = quad.rect.y + ch.size.y * scale;
+			quad.uv = ch.uv;
+			penX += (ch.advance >> 6) * scale;
+
+			// Wrap the whole word if it does not start the line
+			if(maxWidth > 0.f && penX - x > maxWidth && wordStartX > x){
+				GLfloat shift = wordStartX - x;
+				glm::vec4 offset(shift, this->lineHeight * scale, shift, this->lineHeight * scale);
+				for(size_t i = wordStart; i < quads.size(); i++){
+					quads[i].rect -= offset;
+				}
+				quad.rect -= offset;
+				penX -= shift;
+				penY -= this->lineHeight * scale;
+				wordStartX = x;
+			}
+			if(ch.size.x > 0){
+				quads.push_back(quad);
+			}
+		}
+	}
+};
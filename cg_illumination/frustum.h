@@ -0,0 +1,97 @@
+#pragma once
+
+#include <xmmintrin.h>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Six planes with normals pointing inside (left, right, bottom, top, near, far), xyz is the unit normal and w the
+// distance, so dot(plane.xyz, p) + plane.w is the signed distance of p.
+// Extracted from a matrix that maps into clip space (Gribb and Hartmann): with projection * view the planes are in
+// world space, with a model-view-projection matrix they are in the model space of that draw.
+struct Frustum{
+	glm::vec4 planes[6];
+
+	Frustum(){
+		for(int i = 0; i < 6; i++){
+			this->planes[i] = glm::vec4(0.f, 0.f, 0.f, 1.f);
+		}
+	}
+
+	explicit Frustum(const glm::mat4& matrix){
+		glm::vec4 rows[4];
+		for(int i = 0; i < 4; i++){
+			rows[i] = glm::vec4(matrix[0][i], matrix[1][i], matrix[2][i], matrix[3][i]);
+		}
+		for(int i = 0; i < 3; i++){
+			this->planes[i * 2] = rows[3] + rows[i];
+			this->planes[i * 2 + 1] = rows[3] - rows[i];
+		}
+		for(int i = 0; i < 6; i++){
+			GLfloat length = glm::length(glm::vec3(this->planes[i]));
+			if(length > 0.f){
+				this->planes[i] /= length;
+			}
+		}
+	}
+
+	// False only if the sphere lies completely outside one of the planes
+	bool containsSphere(const glm::vec3& center, GLfloat radius) const{
+		for(int i = 0; i < 6; i++){
+			if(glm::dot(glm::vec3(this->planes[i]), center) + this->planes[i].w < -radius){
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// False only if the box lies completely outside one of the planes, tested with its corner furthest along the normal
+	bool containsBox(const glm::vec3& minimum, const glm::vec3& maximum) const{
+		for(int i = 0; i < 6; i++){
+			glm::vec3 normal(this->planes[i]);
+			glm::vec3 corner(normal.x >= 0.f ? maximum.x : minimum.x, normal.y >= 0.f ? maximum.y : minimum.y,
+				normal.z >= 0.f ? maximum.z : minimum.z);
+			if(glm::dot(normal, corner) + this->planes[i].w < 0.f){
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// containsSphere for count spheres (center xyz, radius w) four at a time with SSE, visible gets 1 or 0 per
+	// sphere. Returns the number of visible spheres.
+	size_t containsSpheres(const glm::vec4* spheres, size_t count, unsigned char* visible) const{
+		__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+		for(int i = 0; i < 6; i++){
+			planeX[i] = _mm_set1_ps(this->planes[i].x);
+			planeY[i] = _mm_set1_ps(this->planes[i].y);
+			planeZ[i] = _mm_set1_ps(this->planes[i].z);
+			planeW[i] = _mm_set1_ps(this->planes[i].w);
+		}
+
+		size_t nrOfVisible = 0;
+		for(size_t i = 0; i < count; i += 4){
+			// The last group is padded with copies of the first sphere, their results are dropped
+			__m128 x = _mm_loadu_ps(&spheres[i].x);
+			__m128 y = i + 1 < count ? _mm_loadu_ps(&spheres[i + 1].x) : x;
+			__m128 z = i + 2 < count ? _mm_loadu_ps(&spheres[i + 2].x) : x;
+			__m128 r = i + 3 < count ? _mm_loadu_ps(&spheres[i + 3].x) : x;
+			_MM_TRANSPOSE4_PS(x, y, z, r);
+			__m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), r);
+
+			__m128 outside = _mm_setzero_ps();
+			for(int j = 0; j < 6; j++){
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[j], x), _mm_mul_ps(planeY[j], y)),
+					_mm_add_ps(_mm_mul_ps(planeZ[j], z), planeW[j]));
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, negativeRadius));
+			}
+
+			int mask = _mm_movemask_ps(outside);
+			for(size_t k = 0; k < 4 && i + k < count; k++){
+				visible[i + k] = (mask & (1 << k)) ? 0 : 1;
+				nrOfVisible += visible[i + k];
+			}
+		}
+		return nrOfVisible;
+	}
+};
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+
+#include <glad/glad.h>
+
+#include "vertex.h"
+
+// Range of a mesh inside the shared vertex and index buffers of a GeometryHeap
+struct GeometryAllocation{
+	GLuint baseVertex;
+	GLuint nrOfVertices;
+	GLuint firstIndex;
+	GLuint nrOfIndices;
+};
+
+// Layout expected by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand{
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLuint baseVertex;
+	GLuint baseInstance;
+};
+
+// One VAO with one big VBO and EBO that all meshes suballocate their vertex and index ranges from
+class GeometryHeap{
+private:
+	GLuint VAO;
+	GLuint VBO;
+	GLuint EBO;
+
+	GLuint vertexCapacity;
+	GLuint indexCapacity;
+
+	// Free ranges as offset -> size, measured in vertices and indices
+	std::map<GLuint, GLuint> freeVertices;
+	std::map<GLuint, GLuint> freeIndices;
+
+	void initVAO(){
+		//Create VAO
+		glGenVertexArrays(1, &this->VAO);
+		glBindVertexArray(this->VAO);
+
+		//GEN VBO AND EBO AND RESERVE STORAGE
+		glGenBuffers(1, &this->VBO);
+		glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
+		glBufferData(GL_ARRAY_BUFFER, this->vertexCapacity * sizeof(Vertex), NULL, GL_STATIC_DRAW);
+
+		glGenBuffers(1, &this->EBO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->EBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->indexCapacity * sizeof(GLuint), NULL, GL_STATIC_DRAW);
+
+		this->setAttribPointers();
+
+		//BIND VAO 0
+		glBindVertexArray(0);
+	}
+
+	// Same vertex layout as Mesh::initVAO, the VAO has to be bound
+	void setAttribPointers(){
+		glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
+		//Position
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, position));
+		glEnableVertexAttribArray(0);
+		//Color
+		glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, color));
+		glEnableVertexAttribArray(1);
+		//Texcoord
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, texcoord));
+		glEnableVertexAttribArray(2);
+		//Normal
+		glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, normal));
+		glEnableVertexAttribArray(3);
+	}
+
+	// First fit search in a free list
+	bool allocateRange(std::map<GLuint, GLuint>& freeList, GLuint size, GLuint& offset){
+		for(auto it = freeList.begin(); it != freeList.end(); it++){
+			if(it->second >= size){
+				offset = it->first;
+				GLuint remaining = it->second - size;
+				freeList.erase(it);
+				if(remaining > 0){
+					freeList[offset + size] = remaining;
+				}
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Return a range to a free list and merge it with its neighbours
+	void releaseRange(std::map<GLuint, GLuint>& freeList, GLuint offset, GLuint size){
+		if(size == 0){
+			return;
+		}
+		auto next = freeList.lower_bound(offset);
+		if(next != freeList.end() && offset + size == next->first){
+			size += next->second;
+			next = freeList.erase(next);
+		}
+		if(next != freeList.begin()){
+			auto prev = std::prev(next);
+			if(prev->first + prev->second == offset){
+				prev->second += size;
+				return;
+			}
+		}
+		freeList[offset] = size;
+	}
+
+	// Reallocate a buffer with more room and copy the used part over
+	void growBuffer(GLuint& buffer, GLsizeiptr oldSize, GLsizeiptr newSize){
+		GLuint newBuffer;
+		glGenBuffers(1, &newBuffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, newSize, NULL, GL_STATIC_DRAW);
+		glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		glDeleteBuffers(1, &buffer);
+		buffer = newBuffer;
+	}
+
+	void growVertices(GLuint minimum){
+		GLuint newCapacity = std::max(this->vertexCapacity * 2, this->vertexCapacity + minimum);
+		this->growBuffer(this->VBO, this->vertexCapacity * sizeof(Vertex), newCapacity * sizeof(Vertex));
+		this->releaseRange(this->freeVertices, this->vertexCapacity, newCapacity - this->vertexCapacity);
+		this->vertexCapacity = newCapacity;
+
+		// The VAO still points at the old buffer
+		glBindVertexArray(this->VAO);
+		this->setAttribPointers();
+		glBindVertexArray(0);
+	}
+
+	void growIndices(GLuint minimum){
+		GLuint newCapacity = std::max(this->indexCapacity * 2, this->indexCapacity + minimum);
+		this->growBuffer(this->EBO, this->indexCapacity * sizeof(GLuint), newCapacity * sizeof(GLuint));
+		this->releaseRange(this->freeIndices, this->indexCapacity, newCapacity - this->indexCapacity);
+		this->indexCapacity = newCapacity;
+
+		glBindVertexArray(this->VAO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->EBO);
+		glBindVertexArray(0);
+	}
+
+public:
+	GeometryHeap(GLuint vertexCapacity = 1 << 20, GLuint indexCapacity = 1 << 22){
+		this->vertexCapacity = vertexCapacity;
+		this->indexCapacity = indexCapacity;
+		this->freeVertices[0] = vertexCapacity;
+		this->freeIndices[0] = indexCapacity;
+
+		this->initVAO();
+	}
+
+	~GeometryHeap(){
+		glDeleteVertexArrays(1, &this->VAO);
+		glDeleteBuffers(1, &this->VBO);
+		glDeleteBuffers(1, &this->EBO);
+	}
+
+	//Accessors
+	inline GLuint getVAO() const{return this->VAO;}
+	inline GLuint getVertexCapacity() const{return this->vertexCapacity;}
+	inline GLuint getIndexCapacity() const{return this->indexCapacity;}
+
+	//Functions
+
+	// Reserve ranges for a mesh and upload its data, indices stay relative to baseVertex
+	GeometryAllocation allocate(const Vertex* vertices, GLuint nrOfVertices, const GLuint* indices, GLuint nrOfIndices){
+		GeometryAllocation allocation = {0, nrOfVertices, 0, nrOfIndices};
+
+		if(!this->allocateRange(this->freeVertices, nrOfVertices, allocation.baseVertex)){
+			this->growVertices(nrOfVertices);
+			this->allocateRange(this->freeVertices, nrOfVertices, allocation.baseVertex);
+		}
+		if(!this->allocateRange(this->freeIndices, nrOfIndices, allocation.firstIndex)){
+			this->growIndices(nrOfIndices);
+			this->allocateRange(this->freeIndices, nrOfIndices, allocation.firstIndex);
+		}
+
+		glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
+		glBufferSubData(GL_ARRAY_BUFFER, allocation.baseVertex * sizeof(Vertex), nrOfVertices * sizeof(Vertex), vertices);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		// The element buffer binding is VAO state, so upload through the copy target
+		glBindBuffer(GL_COPY_WRITE_BUFFER, this->EBO);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.firstIndex * sizeof(GLuint), nrOfIndices * sizeof(GLuint), indices);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+		return allocation;
+	}
+
+	void release(const GeometryAllocation& allocation){
+		this->releaseRange(this->freeVertices, allocation.baseVertex, allocation.nrOfVertices);
+		this->releaseRange(this->freeIndices, allocation.firstIndex, allocation.nrOfIndices);
+	}
+
+	void bind(){
+		glBindVertexArray(this->VAO);
+	}
+
+	void unbind(){
+		glBindVertexArray(0);
+	}
+};
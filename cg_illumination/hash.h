@@ -0,0 +1,34 @@
+#pragma once
+
+#include <fstream>
+
+// 64 bit FNV-1a, used to key the on-disk caches by the content they were built from
+class Hash{
+public:
+	static const unsigned long long OFFSET = 14695981039346656037ull;
+	static const unsigned long long PRIME = 1099511628211ull;
+
+	// Continued from hash, so several buffers can be hashed as one
+	static unsigned long long bytes(const void* data, size_t size, unsigned long long hash = OFFSET){
+		const unsigned char* input = (const unsigned char*)data;
+		for(size_t i = 0; i < size; i++){
+			hash ^= input[i];
+			hash *= PRIME;
+		}
+		return hash;
+	}
+
+	// 0 if the file can't be opened
+	static unsigned long long file(const char* path){
+		std::ifstream in_file(path, std::ios::binary);
+		if(!in_file){
+			return 0;
+		}
+		unsigned long long hash = OFFSET;
+		char buffer[4096];
+		while(in_file.read(buffer, sizeof(buffer)) || in_file.gcount() > 0){
+			hash = bytes(buffer, (size_t)in_file.gcount(), hash);
+		}
+		return hash;
+	}
+};
@@ -0,0 +1,41 @@
+// Phong lighting shared by the main fragment shaders, pulled in with #include "lighting.glsl".
+// Permutations, set through ShaderLibrary::get(name, defines):
+//   LIGHT_COUNT       number of point lights in lightPos, 1 if not defined
+//   DISABLE_SPECULAR  leaves out the specular term, the unused texture fetch is then removed by the compiler
+
+#ifndef LIGHT_COUNT
+#define LIGHT_COUNT 1
+#endif
+
+uniform vec3 lightPos[LIGHT_COUNT];
+uniform vec3 cameraPos;
+
+vec3 calculateDiffuse(vec3 diffuse, vec3 shaderPosition, vec3 shaderNormal, vec3 lightPos0){
+	vec3 posToLightDirVec = normalize(lightPos0 - shaderPosition);
+	float diffuseConstant = clamp(dot(posToLightDirVec, shaderNormal), 0, 1);
+	vec3 diffuseFinal = diffuse * diffuseConstant;
+
+	return diffuseFinal;
+}
+
+vec3 calculateSpecular(vec3 specular, vec3 shaderPosition, vec3 shaderNormal, vec3 lightPos0, vec3 cameraPos){
+	vec3 lightToPosDirVec = normalize(shaderPosition - lightPos0);
+	vec3 reflectDirVec = normalize(reflect(lightToPosDirVec, normalize(shaderNormal)));
+	vec3 posToViewDirVec = normalize(cameraPos - shaderPosition);
+	float specularConstant = pow(max(dot(posToViewDirVec, reflectDirVec), 0), 35);
+	vec3 specularFinal = specular * specularConstant;
+
+	return specularFinal;
+}
+
+// Ambient plus the diffuse and specular light of every light, specularSample scales the specular term
+vec3 calculateLighting(vec3 ambient, vec3 diffuse, vec3 specular, vec3 specularSample, vec3 shaderPosition, vec3 shaderNormal){
+	vec3 lightFinal = ambient;
+	for(int i = 0; i < LIGHT_COUNT; i++){
+		lightFinal += calculateDiffuse(diffuse, shaderPosition, shaderNormal, lightPos[i]);
+#ifndef DISABLE_SPECULAR
+		lightFinal += calculateSpecular(specular, shaderPosition, shaderNormal, lightPos[i], cameraPos) * specularSample;
+#endif
+	}
+	return lightFinal;
+}
@@ -1,6 +1,8 @@
 #include <iostream>
 #include <cmath>
 #include <vector>
+#include <string>
+#include <cstdlib>
 
 // GLAD
 #include <glad/glad.h>
@@ -26,12 +28,23 @@
 // Other includes
 #include "camera.h"
 #include "shader.h"
+#include "shaderLibrary.h"
 #include "vertex.h"
 #include "primitives.h"
 #include "texture.h"
+#include "textureLoader.h"
+#include "textureStreamer.h"
+#include "textureCache.h"
 #include "material.h"
 #include "mesh.h"
 #include "object.h"
+#include "staticBatcher.h"
+#include "geometryHeap.h"
+#include "drawBatcher.h"
+#include "streamBuffer.h"
+#include "atomicCounter.h"
+#include "tessellationCache.h"
+#include "patchFitter.h"
 #include "planets.h"
 
 // Function prototypes
@@ -60,17 +73,25 @@ GLfloat angle_x = 0.0f;
 GLfloat rot_speed = 40.0f;
 glm::quat rot_quat = glm::angleAxis(angle_x, glm::vec3(1, 0, 0));
 
-// Tesselation
+// Tesselation, target triangle edge length in pixels
 GLfloat level = 5.f;
 bool line_mode = false;
 
 // The MAIN function, from here we start the application and run the game loop
-int main(){
+// --fit-patches <mesh> <output> [tolerance] converts a triangle mesh to Bézier patches and exits,
+// --patches <file> shows a fitted patch file next to the triangle mesh
+int main(int argc, char** argv){
+	if(argc >= 4 && std::string(argv[1]) == "--fit-patches"){
+		float tolerance = argc >= 5 ? (float)atof(argv[4]) : 0.005f;
+		return PatchFitter::fit(argv[2], argv[3], tolerance) ? 0 : 1;
+	}
+	const char* patchPath = argc >= 3 && std::string(argv[1]) == "--patches" ? argv[2] : nullptr;
+
 	// Init GLFW
 	glfwInit();
 	// Set all the required options for GLFW
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-	//glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 #ifdef __APPLE__
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
@@ -92,85 +113,225 @@ int main(){
 		return -1;
 	}
 
-	// Build and compile shader program
-	Shader shader(4, 1, "main.vert.glsl", "main.frag.glsl");
-
-	// Load and create textures
-	std::vector<Texture*> textures;
-	textures.push_back(new Texture("white.jpg", GL_TEXTURE_2D));
-
-	// Create materials
-	Material* material = new Material(glm::vec3(0.1f), glm::vec3(0.7f), glm::vec3(0.5f), 0, 1);
-
-	// Lights
-	glm::vec3 light(5.f, 5.f, 5.f);
-	shader.setVec3f(light, "lightPos0");
-
-	// Set up vertex data (and buffer(s)) and attribute pointers
-	std::vector<Mesh*> meshes;
-	Mesh* model = new Mesh("eight.txt");
-	meshes.push_back(model);
-	Object surface(glm::vec3(0.f), material, textures[0], textures[0], meshes);
-
-	// enable transparency
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
-	glCullFace(GL_BACK);
-	glFrontFace(GL_CCW);
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-
-	GLfloat cooldown = 0.f;
-
-	// Game loop
-	while(!glfwWindowShouldClose(window)){
-		// Calculate deltatime of current frame
-		GLfloat currentFrame = glfwGetTime();
-		deltaTime = currentFrame - lastFrame;
-		lastFrame = currentFrame;
-
-		// Check if any events have been activiated (key pressed, mouse moved etc.) and call corresponding response functions
-		glfwPollEvents();
-		cooldown -= deltaTime;
-		if(cooldown < 0)
-			cooldown = 0;
-		DoMovement(cooldown);
-
-		// Render
-		// Clear the colorbuffer
-		glClearColor(.0f, .0f, .0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT);
-
-		// Camera/View transformation
-		glm::mat4 view(1);
-		view = camera.getViewMatrix();
-		// Projection
-		glm::mat4 projection(1);
-		projection = camera.getProjectionMatrix((GLfloat)WIDTH, (GLfloat)HEIGHT);
-		shader.setMat4fv(view, "view");
-		shader.setMat4fv(projection, "projection");
-		shader.setVec3f(camera.getPosition(), "cameraPos");
-
-		// Apply keyboard rotation
-		surface.rotateAroundOrigin(glm::eulerAngles(rot_quat));
-
-		// Toggle display mode
-		if(line_mode){
-			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-		}else{
-			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	// Everything owning GL objects lives in this block, so it is destroyed while the context exists and the meshes
+	// are released before the heap they live in
+	{
+		// Build and compile shader programs, the driver compiles them all in parallel until one is first used
+		ShaderLibrary shaders(4, 6);
+		Shader* shader = shaders.add("main", "main.vert_batch.glsl", "main.frag.glsl");
+		// Quartic Bézier patches, tessellated to about level pixels per triangle edge
+		Shader* patchShader = shaders.add("patch", "main.vert_patch.glsl", "main.frag.glsl", "", "main.tcs.glsl", "main.tes.glsl");
+		// Tessellated once into a transform feedback buffer and redrawn from there while the view and the level hold still
+		Shader* captureShader = shaders.get("patch", {{"CAPTURE", "1"}});
+		Shader* cachedShader = shaders.add("cached", "main.vert_cached.glsl", "main.frag.glsl");
+		// Edited shader files are rebuilt while the application runs
+		shaders.watch();
+
+		// Load and create textures, decoding happens on worker threads and placeholders are bound until the upload is done.
+		// The cache hands out one shared texture per file and parameters, so the same file is only loaded once.
+		// Scene textures start as their mip tail, larger levels stream in as objects grow on screen
+		TextureLoader textureLoader;
+		TextureStreamer textureStreamer;
+		TextureCache textureCache(256 << 20, &textureLoader, &textureStreamer);
+		Texture* diffuse = textureCache.acquire("white.jpg", TextureParameters::stream());
+		Texture* specular = textureCache.acquire("white.jpg", TextureParameters::stream());
+
+		// Create materials
+		Material* material = new Material(glm::vec3(0.1f), glm::vec3(0.7f), glm::vec3(0.5f), 0, 1);
+
+		// Lights
+		glm::vec3 light(5.f, 5.f, 5.f);
+		shader->setVec3f(light, "lightPos[0]");
+		patchShader->setVec3f(light, "lightPos[0]");
+		cachedShader->setVec3f(light, "lightPos[0]");
+
+		// Share one VAO between all meshes and draw them with multi draw indirect
+		GeometryHeap heap;
+		StreamBuffer stream;
+		DrawBatcher batcher(&heap, &stream);
+		ClusterCuller culler;
+
+		// Set up vertex data (and buffer(s)) and attribute pointers
+		std::vector<Mesh*> meshes;
+		Mesh* model = new Mesh("eight.txt");
+		meshes.push_back(model);
+		Object surface(glm::vec3(0.f), material, diffuse, specular, meshes);
+		// Simplified levels, picked per frame so the surface has at most a pixel of error on screen
+		surface.generateLods();
+		// Clusters of up to 128 triangles, only those in view and facing the camera are drawn
+		surface.buildClusters();
+
+		// Static floor of tiles with a ring of pyramids, merged into a few batches per 8 unit grid cell
+		Material* floorMaterial = new Material(glm::vec3(0.05f), glm::vec3(0.4f), glm::vec3(0.1f), 0, 1);
+		Quad tile;
+		Pyramid pyramid;
+		StaticBatcher staticBatcher(65536, 8.f);
+		std::vector<Mesh*> sceneryMeshes;
+		for(int x = -12; x < 12; x++){
+			for(int z = -12; z < 12; z++){
+				sceneryMeshes.push_back(new Mesh(&tile, glm::vec3(x + 0.5f, -3.f, z + 0.5f), glm::vec3(0.f), glm::vec3(0.f),
+					glm::vec3(-90.f, 0.f, 0.f)));
+			}
+		}
+		for(int i = 0; i < 16; i++){
+			GLfloat angle = i * 2.f * (GLfloat)M_PI / 16.f;
+			sceneryMeshes.push_back(new Mesh(&pyramid, glm::vec3(8.f * cos(angle), -2.5f, 8.f * sin(angle))));
+		}
+		for(auto* i : sceneryMeshes){
+			staticBatcher.add(i, floorMaterial, diffuse, specular);
+		}
+		std::vector<Object*> scenery = staticBatcher.build();
+		for(auto*& i : sceneryMeshes){
+			delete i;
 		}
 
-		// Render control points
-		surface.render(&shader);
-		
-		rot_quat = glm::angleAxis(angle_x, glm::vec3(1, 0, 0));
-		glClear(GL_DEPTH_BUFFER_BIT);
+		Mesh* patchModel = nullptr;
+		TessellationCache* tessellationCache = nullptr;
+		if(patchPath){
+			patchModel = new Mesh(patchPath, glm::vec3(3.f, 0.f, 0.f));
+			if(patchModel->hasPatches()){
+				tessellationCache = new TessellationCache();
+			}else{
+				std::cout << "ERROR::MAIN::NOT_A_PATCH_FILE: " << patchPath << "\n";
+			}
+		}
+
+		// Bézier patches main.tcs.glsl dropped as off screen or back facing, on the last frame that tessellated
+		AtomicCounter culledPatches(0);
+		GLuint shownCulledPatches = 0;
+		unsigned surfaceTriangles = 0;
+		unsigned shownSurfaceTriangles = 0;
+		size_t shownVisibleClusters = 0;
+		unsigned shownVisibleMeshes = 0;
+		surface.attachToHeap(&heap);
+		for(auto* i : scenery){
+			i->attachToHeap(&heap);
+		}
 
-		// Swap the screen buffers
-		glfwSwapBuffers(window);
+		// enable transparency
+		glEnable(GL_DEPTH_TEST);
+		glEnable(GL_CULL_FACE);
+		glCullFace(GL_BACK);
+		glFrontFace(GL_CCW);
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+		GLfloat cooldown = 0.f;
+
+		// Game loop
+		while(!glfwWindowShouldClose(window)){
+			// Calculate deltatime of current frame
+			GLfloat currentFrame = glfwGetTime();
+			deltaTime = currentFrame - lastFrame;
+			lastFrame = currentFrame;
+
+			// Check if any events have been activiated (key pressed, mouse moved etc.) and call corresponding response functions
+			glfwPollEvents();
+			cooldown -= deltaTime;
+			if(cooldown < 0)
+				cooldown = 0;
+			DoMovement(cooldown);
+
+			// Wait until the GPU is done with the oldest region of streamed data
+			stream.beginFrame();
+
+			// Upload textures that finished decoding, then trim the cache to its budget once they are all in
+			textureLoader.update();
+			textureCache.update();
+
+			// Swap in shaders rebuilt after their files changed
+			shaders.update();
+
+			// Render
+			// Clear the colorbuffer
+			glClearColor(.0f, .0f, .0f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT);
+
+			// Camera/View transformation
+			glm::mat4 view(1);
+			view = camera.getViewMatrix();
+			// Projection
+			glm::mat4 projection(1);
+			projection = camera.getProjectionMatrix((GLfloat)WIDTH, (GLfloat)HEIGHT);
+			shader->setViewProjection(view, projection);
+			shader->setVec3f(camera.getPosition(), "cameraPos");
+			patchShader->setViewProjection(view, projection);
+			patchShader->setVec3f(camera.getPosition(), "cameraPos");
+			patchShader->setVec2f(glm::vec2(WIDTH, HEIGHT), "viewport");
+			captureShader->setViewProjection(view, projection);
+			captureShader->setVec3f(camera.getPosition(), "cameraPos");
+			captureShader->setVec2f(glm::vec2(WIDTH, HEIGHT), "viewport");
+			cachedShader->setViewProjection(view, projection);
+			cachedShader->setVec3f(camera.getPosition(), "cameraPos");
+
+			// Apply keyboard rotation
+			surface.rotateAroundOrigin(glm::eulerAngles(rot_quat));
+			surfaceTriangles = surface.selectLods(camera.getPosition(), projection, (GLfloat)HEIGHT);
+
+			// Stream in the mip levels the objects need at their current size on screen
+			textureStreamer.request(&surface, view, projection, (GLfloat)HEIGHT);
+			for(auto* i : scenery){
+				textureStreamer.request(i, view, projection, (GLfloat)HEIGHT);
+			}
+			textureStreamer.update();
+
+			// Toggle display mode
+			if(line_mode){
+				glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+			}else{
+				glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+			}
+
+			// Render control points
+			batcher.begin();
+			Frustum frustum = camera.getFrustum((GLfloat)WIDTH, (GLfloat)HEIGHT);
+			culler.begin();
+			surface.submit(&culler, &frustum);
+			culler.flush(&batcher, shader->getViewProjection(), camera.getPosition());
+			for(auto* i : scenery){
+				i->submit(&batcher, &frustum);
+			}
+			batcher.flush(shader, shader->getViewProjection());
+
+			// Render fitted patches, the live and the cached program both shade with main.frag.glsl
+			if(tessellationCache){
+				material->sendToShader(*patchShader);
+				material->sendToShader(*cachedShader);
+				diffuse->bind(0);
+				specular->bind(1);
+				tessellationCache->render(patchModel, patchShader, captureShader, cachedShader, level, &culledPatches);
+			}
+			
+			rot_quat = glm::angleAxis(angle_x, glm::vec3(1, 0, 0));
+			glClear(GL_DEPTH_BUFFER_BIT);
+			stream.endFrame();
+
+			// The count arrives a few frames late
+			if(culledPatches.getValue() != shownCulledPatches || surfaceTriangles != shownSurfaceTriangles ||
+				culler.getNrOfVisible() != shownVisibleClusters || surface.getNrOfVisibleMeshes() != shownVisibleMeshes){
+				shownCulledPatches = culledPatches.getValue();
+				shownSurfaceTriangles = surfaceTriangles;
+				shownVisibleClusters = culler.getNrOfVisible();
+				shownVisibleMeshes = surface.getNrOfVisibleMeshes();
+				glfwSetWindowTitle(window, ("Illumination - culled patches: " + std::to_string(shownCulledPatches) +
+					", surface triangles: " + std::to_string(shownSurfaceTriangles) +
+					", clusters: " + std::to_string(shownVisibleClusters) + "/" + std::to_string(culler.getNrOfClusters()) +
+					", meshes: " + std::to_string(shownVisibleMeshes) + " visible, " +
+					std::to_string(surface.getNrOfCulledMeshes()) + " culled").c_str());
+			}
+
+			// Swap the screen buffers
+			glfwSwapBuffers(window);
+		}
+		delete tessellationCache;
+		delete patchModel;
+		for(auto*& i : scenery){
+			delete i;
+		}
+		delete floorMaterial;
 	}
+
 	// Terminate GLFW, clearing any resources allocated by GLFW.
 	glfwTerminate();
 	return 0;
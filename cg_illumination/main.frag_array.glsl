@@ -0,0 +1,34 @@
+#version 460 core
+
+// material of every draw of the multi draw, written by DrawBatcher, w holds the texture array layer
+struct DrawMaterial{
+	vec4 ambient;
+	vec4 diffuse;
+	vec4 specular;
+};
+
+layout(std430, binding = 2) readonly buffer DrawMaterials{
+	DrawMaterial materials[];
+};
+
+in vec3 shaderPosition;
+in vec4 shaderColor;
+in vec2 shaderTexCoord;
+in vec3 shaderNormal;
+flat in int shaderDrawIndex;
+
+uniform sampler2DArray textures;
+
+out vec4 finalColor;
+
+#include "lighting.glsl"
+
+void main(){
+	DrawMaterial material = materials[shaderDrawIndex];
+
+	vec3 specularSample = texture(textures, vec3(shaderTexCoord, material.specular.w)).rgb;
+	vec3 lightFinal = calculateLighting(material.ambient.rgb, material.diffuse.rgb, material.specular.rgb, specularSample, shaderPosition, shaderNormal);
+
+	//Final light
+	finalColor = texture(textures, vec3(shaderTexCoord, material.diffuse.w)) * shaderColor * vec4(lightFinal, 1.f);
+}
\ No newline at end of file
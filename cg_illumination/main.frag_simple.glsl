@@ -1,20 +1,16 @@
 #version 410 core
 
-struct Material{
-	vec3 ambient;
-	vec3 diffuse;
-	vec3 specular;
-	sampler2D diffuseTex;
-	sampler2D specularTex;
-};
-
 in vec2 shaderTexCoord;
 
-uniform Material material;
-
 out vec4 finalColor;
 
+#include "material.glsl"
+
 void main(){
-    finalColor = texture(material.diffuseTex, shaderTexCoord);
+#ifdef DISABLE_TEXTURE
+    finalColor = vec4(material.diffuse, 1.0f);
+#else
+    finalColor = sampleDiffuse(shaderTexCoord);
+#endif
     //finalColor = vec4(1.0f, 0.5f, 0.2f, 1.0f);
 }
\ No newline at end of file
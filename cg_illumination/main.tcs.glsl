@@ -1,16 +1,128 @@
-#version 410 core
+#version 460 core
 
 layout(vertices = 25) out;
 
-uniform float uOuterH, uOuterV, uInnerV, uInnerH;
+uniform mat4 model;
+uniform mat4 mvp;
+uniform vec3 cameraPos;
+uniform vec2 viewport;          // Framebuffer size in pixels
+uniform float triangleSize;     // Target edge length of the generated triangles in pixels
+uniform bool cullBackFaces = true;
+
+// Patches that were dropped before tessellation, read back by AtomicCounter
+layout(binding = 0, offset = 0) uniform atomic_uint culledPatches;
+
+// Control point (i, j) of the 5x5 net, i runs along u and j along v like in main.tes.glsl
+vec4 controlPoint(int i, int j){
+	return gl_in[i + 5 * j].gl_Position;
+}
+
+vec2 screenPoint(int i, int j){
+	vec4 clip = mvp * controlPoint(i, j);
+	// Points behind the eye project far away, which gives the edge the maximum level
+	return clip.xy / max(clip.w, 1e-4) * 0.5 * viewport;
+}
+
+// Screen space length of the control polygon of one boundary curve, which bounds the length of the curve.
+// The sum is symmetric so the patch on the other side of the edge, which walks it backwards, gets the same level.
+float edgeLevel(vec2 p0, vec2 p1, vec2 p2, vec2 p3, vec2 p4){
+	float polygon = (distance(p0, p1) + distance(p3, p4)) + (distance(p1, p2) + distance(p2, p3));
+	return clamp(polygon / max(triangleSize, 1.f), 1.f, float(gl_MaxTessGenLevel));
+}
+
+// The patch lies in the convex hull of its control points, so it is invisible if all of them are outside one plane
+bool outsideFrustum(){
+	int outside = 63;
+	for(int i = 0; i < 25; i++){
+		vec4 clip = mvp * gl_in[i].gl_Position;
+		int planes = (clip.x < -clip.w ? 1 : 0) | (clip.x > clip.w ? 2 : 0)
+			| (clip.y < -clip.w ? 4 : 0) | (clip.y > clip.w ? 8 : 0)
+			| (clip.z < -clip.w ? 16 : 0) | (clip.z > clip.w ? 32 : 0);
+		outside &= planes;
+	}
+	return outside != 0;
+}
+
+// Cone of normals: the normals of the 4x4 control net quads approximate the normals of the patch. If the eye sees
+// every normal in the cone around their average from behind, from every control point, the patch faces away.
+// Works in model space, the sign of dot(normal, eye - point) doesn't change under the model transform.
+bool backFacing(){
+	vec3 normals[16];
+	vec3 axis = vec3(0.f);
+	for(int j = 0; j < 4; j++){
+		for(int i = 0; i < 4; i++){
+			// Counter clockwise in (u, v), the diagonals' cross product is twice du x dv
+			vec3 diagonal0 = controlPoint(i + 1, j + 1).xyz - controlPoint(i, j).xyz;
+			vec3 diagonal1 = controlPoint(i, j + 1).xyz - controlPoint(i + 1, j).xyz;
+			vec3 normal = cross(diagonal0, diagonal1);
+			float normalLength = length(normal);
+			normals[i + 4 * j] = normalLength > 0.f ? normal / normalLength : vec3(0.f);
+			axis += normals[i + 4 * j];
+		}
+	}
+	float axisLength = length(axis);
+	if(axisLength < 1e-6){
+		return false;
+	}
+	axis /= axisLength;
+
+	float cosAngle = 1.f;
+	for(int i = 0; i < 16; i++){
+		if(normals[i] != vec3(0.f)){
+			cosAngle = min(cosAngle, dot(axis, normals[i]));
+		}
+	}
+	// A cone wider than a half space always has a normal facing the eye
+	if(cosAngle <= 0.f){
+		return false;
+	}
+	float sinAngle = sqrt(1.f - cosAngle * cosAngle);
+
+	vec3 eye = vec3(inverse(model) * vec4(cameraPos, 1.f));
+	for(int i = 0; i < 25; i++){
+		vec3 toEye = normalize(eye - gl_in[i].gl_Position.xyz);
+		if(dot(axis, toEye) >= -sinAngle){
+			return false;
+		}
+	}
+	return true;
+}
 
 void main(){
 	gl_out[gl_InvocationID].gl_Position = gl_in[gl_InvocationID].gl_Position;
-	// set tessellation levels
-	gl_TessLevelOuter[0] = uOuterH;
-    gl_TessLevelOuter[1] = uOuterV;
-    gl_TessLevelOuter[2] = uOuterH;
-    gl_TessLevelOuter[3] = uOuterV;
-    gl_TessLevelInner[0] = uInnerV;
-    gl_TessLevelInner[1] = uInnerH;
-}
\ No newline at end of file
+
+	// The levels are per patch, one invocation is enough
+	if(gl_InvocationID == 0){
+		// An outer level of 0 discards the patch before the tessellator. TessellationCache only redraws a
+		// captured surface from the view it was captured in, so culling applies to captures as well.
+		if(outsideFrustum() || (cullBackFaces && backFacing())){
+			atomicCounterIncrement(culledPatches);
+			gl_TessLevelOuter[0] = 0.f;
+			gl_TessLevelOuter[1] = 0.f;
+			gl_TessLevelOuter[2] = 0.f;
+			gl_TessLevelOuter[3] = 0.f;
+			gl_TessLevelInner[0] = 0.f;
+			gl_TessLevelInner[1] = 0.f;
+			return;
+		}
+
+		vec2 u0[5];
+		vec2 u1[5];
+		vec2 v0[5];
+		vec2 v1[5];
+		for(int k = 0; k < 5; k++){
+			u0[k] = screenPoint(0, k);
+			u1[k] = screenPoint(4, k);
+			v0[k] = screenPoint(k, 0);
+			v1[k] = screenPoint(k, 4);
+		}
+
+		// Outer levels only depend on the shared boundary curve, so seams between patches match
+		gl_TessLevelOuter[0] = edgeLevel(u0[0], u0[1], u0[2], u0[3], u0[4]);
+		gl_TessLevelOuter[1] = edgeLevel(v0[0], v0[1], v0[2], v0[3], v0[4]);
+		gl_TessLevelOuter[2] = edgeLevel(u1[0], u1[1], u1[2], u1[3], u1[4]);
+		gl_TessLevelOuter[3] = edgeLevel(v1[0], v1[1], v1[2], v1[3], v1[4]);
+		gl_TessLevelInner[0] = max(gl_TessLevelOuter[1], gl_TessLevelOuter[3]);
+		gl_TessLevelInner[1] = max(gl_TessLevelOuter[0], gl_TessLevelOuter[2]);
+	}
+}
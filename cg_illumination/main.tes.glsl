@@ -1,11 +1,24 @@
 #version 410 core
 
-layout(quads, equal_spacing, ccw) in;
+layout(quads, fractional_odd_spacing, ccw) in;
 
-out vec3 shaderPosition;
-//out vec4 shaderColor;
-out vec2 shaderTexCoord;
-out vec3 shaderNormal;
+uniform mat4 model;
+uniform mat4 mvp;
+uniform mat3 normalMatrix;
+
+// With CAPTURE defined the surface is recorded in model space by TessellationCache instead of being drawn,
+// position, normal and texture coordinate are interleaved into 32 bytes per vertex
+#ifdef CAPTURE
+layout(xfb_buffer = 0, xfb_stride = 32) out;
+#define CAPTURED(offset) layout(xfb_buffer = 0, xfb_offset = offset)
+#else
+#define CAPTURED(offset)
+#endif
+
+CAPTURED(0) out vec3 shaderPosition;
+out vec4 shaderColor;
+CAPTURED(24) out vec2 shaderTexCoord;
+CAPTURED(12) out vec3 shaderNormal;
 
 void main(){
 	vec4 p00 = gl_in[ 0].gl_Position;
@@ -48,10 +61,41 @@ void main(){
     float bv2 = 6. * v * v * (1.-v) * (1.-v);
     float bv3 = 4. * v * v * v * (1.-v);
     float bv4 = v * v * v * v;
+	// derivatives of the basis functions, 4 times the difference of neighbouring cubic ones
+	float du0 = -4. * (1.-u) * (1.-u) * (1.-u);
+	float du1 = 4. * ((1.-u) * (1.-u) * (1.-u) - 3. * u * (1.-u) * (1.-u));
+	float du2 = 4. * (3. * u * (1.-u) * (1.-u) - 3. * u * u * (1.-u));
+	float du3 = 4. * (3. * u * u * (1.-u) - u * u * u);
+	float du4 = 4. * u * u * u;
+	float dv0 = -4. * (1.-v) * (1.-v) * (1.-v);
+	float dv1 = 4. * ((1.-v) * (1.-v) * (1.-v) - 3. * v * (1.-v) * (1.-v));
+	float dv2 = 4. * (3. * v * (1.-v) * (1.-v) - 3. * v * v * (1.-v));
+	float dv3 = 4. * (3. * v * v * (1.-v) - v * v * v);
+	float dv4 = 4. * v * v * v;
+	// the patch collapsed in v to one curve per column of the net, and its v derivative
+	vec4 c0 = bv0*p00 + bv1*p01 + bv2*p02 + bv3*p03 + bv4*p04;
+	vec4 c1 = bv0*p10 + bv1*p11 + bv2*p12 + bv3*p13 + bv4*p14;
+	vec4 c2 = bv0*p20 + bv1*p21 + bv2*p22 + bv3*p23 + bv4*p24;
+	vec4 c3 = bv0*p30 + bv1*p31 + bv2*p32 + bv3*p33 + bv4*p34;
+	vec4 c4 = bv0*p40 + bv1*p41 + bv2*p42 + bv3*p43 + bv4*p44;
+	vec4 d0 = dv0*p00 + dv1*p01 + dv2*p02 + dv3*p03 + dv4*p04;
+	vec4 d1 = dv0*p10 + dv1*p11 + dv2*p12 + dv3*p13 + dv4*p14;
+	vec4 d2 = dv0*p20 + dv1*p21 + dv2*p22 + dv3*p23 + dv4*p24;
+	vec4 d3 = dv0*p30 + dv1*p31 + dv2*p32 + dv3*p33 + dv4*p34;
+	vec4 d4 = dv0*p40 + dv1*p41 + dv2*p42 + dv3*p43 + dv4*p44;
     // finally, we get to compute something:
-    gl_Position = bu0 * (bv0*p00 + bv1*p01 + bv2*p02 + bv3*p03 + bv4*p04)
-				+ bu1 * (bv0*p10 + bv1*p11 + bv2*p12 + bv3*p13 + bv4*p14)
-				+ bu2 * (bv0*p20 + bv1*p21 + bv2*p22 + bv3*p23 + bv4*p24)
-				+ bu3 * (bv0*p30 + bv1*p31 + bv2*p32 + bv3*p33 + bv4*p34)
-				+ bu4 * (bv0*p40 + bv1*p41 + bv2*p42 + bv3*p43 + bv4*p44);
+	vec4 position = bu0*c0 + bu1*c1 + bu2*c2 + bu3*c3 + bu4*c4;
+	vec3 tangentU = (du0*c0 + du1*c1 + du2*c2 + du3*c3 + du4*c4).xyz;
+	vec3 tangentV = (bu0*d0 + bu1*d1 + bu2*d2 + bu3*d3 + bu4*d4).xyz;
+	// Control points are in model space
+	shaderColor = vec4(1.f);
+	// du x dv faces the same way as the counter clockwise triangles, see PatchEvaluator for the CPU version
+#ifdef CAPTURE
+	shaderPosition = position.xyz;
+	shaderNormal = normalize(cross(tangentU, tangentV));
+#else
+	shaderPosition = vec3(model * position);
+	shaderNormal = normalize(normalMatrix * cross(tangentU, tangentV));
+#endif
+	gl_Position = mvp * position;
 }
\ No newline at end of file
@@ -6,8 +6,8 @@ layout(location = 2) in vec2 texCoord;
 layout(location = 3) in vec3 normal;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform mat4 mvp;
+uniform mat3 normalMatrix;
 
 out vec3 shaderPosition;
 out vec4 shaderColor;
@@ -18,7 +18,7 @@ void main(){
     shaderPosition = vec4(model * vec4(position, 1.f)).xyz;
 	shaderColor = color;
 	shaderTexCoord = vec2(texCoord.x, -1.0f + texCoord.y); // textures are flipped here to use sphere properly
-	shaderNormal = normalize(mat3(model) * normal);
+	shaderNormal = normalize(normalMatrix * normal);
 
-	gl_Position = projection * view * model * vec4(position, 1.f);
+	gl_Position = mvp * vec4(position, 1.f);
 }
\ No newline at end of file
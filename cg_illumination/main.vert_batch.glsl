@@ -0,0 +1,37 @@
+#version 460 core
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec4 color;
+layout(location = 2) in vec2 texCoord;
+layout(location = 3) in vec3 normal;
+
+// matrices of every draw of the multi draw, precomputed by DrawBatcher
+struct DrawTransform{
+	mat4 model;
+	mat4 mvp;
+	mat4 normalMatrix;
+};
+
+layout(std430, binding = 0) readonly buffer DrawTransforms{
+	DrawTransform transforms[];
+};
+
+uniform int drawOffset;
+
+out vec3 shaderPosition;
+out vec4 shaderColor;
+out vec2 shaderTexCoord;
+out vec3 shaderNormal;
+flat out int shaderDrawIndex;
+
+void main(){
+	shaderDrawIndex = drawOffset + gl_DrawID;
+	DrawTransform transform = transforms[shaderDrawIndex];
+
+    shaderPosition = vec4(transform.model * vec4(position, 1.f)).xyz;
+	shaderColor = color;
+	shaderTexCoord = vec2(texCoord.x, -1.0f + texCoord.y); // textures are flipped here to use sphere properly
+	shaderNormal = normalize(mat3(transform.normalMatrix) * normal);
+
+	gl_Position = transform.mvp * vec4(position, 1.f);
+}
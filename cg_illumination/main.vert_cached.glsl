@@ -0,0 +1,24 @@
+#version 410 core
+
+// Draws a tessellated surface recorded by TessellationCache, the vertices are in model space
+layout(location = 0) in vec3 position;
+layout(location = 2) in vec2 texCoord;
+layout(location = 3) in vec3 normal;
+
+uniform mat4 model;
+uniform mat4 mvp;
+uniform mat3 normalMatrix;
+
+out vec3 shaderPosition;
+out vec4 shaderColor;
+out vec2 shaderTexCoord;
+out vec3 shaderNormal;
+
+void main(){
+	shaderPosition = vec3(model * vec4(position, 1.f));
+	shaderColor = vec4(1.f);
+	shaderTexCoord = texCoord;
+	shaderNormal = normalize(normalMatrix * normal);
+
+	gl_Position = mvp * vec4(position, 1.f);
+}
@@ -0,0 +1,8 @@
+#version 410 core
+
+// Control points of the Bézier patches stay in model space, the tessellation stages project them
+layout(location = 0) in vec3 position;
+
+void main(){
+	gl_Position = vec4(position, 1.f);
+}
@@ -2,10 +2,8 @@
 
 layout(location = 0) in vec3 position;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform mat4 mvp;
 
 void main(){
-    gl_Position = projection * view * model * vec4(position, 1.f);
+    gl_Position = mvp * vec4(position, 1.f);
 }
\ No newline at end of file
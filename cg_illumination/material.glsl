@@ -0,0 +1,29 @@
+// Material uniform of the main fragment shaders, pulled in with #include "material.glsl".
+// Permutation, set through ShaderLibrary::get(name, defines):
+//   DISABLE_TEXTURE  material colours only, sampleDiffuse and sampleSpecular return white without a texture fetch
+
+struct Material{
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
+	sampler2D diffuseTex;
+	sampler2D specularTex;
+};
+
+uniform Material material;
+
+vec4 sampleDiffuse(vec2 texCoord){
+#ifdef DISABLE_TEXTURE
+	return vec4(1.f);
+#else
+	return texture(material.diffuseTex, texCoord);
+#endif
+}
+
+vec3 sampleSpecular(vec2 texCoord){
+#ifdef DISABLE_TEXTURE
+	return vec3(1.f);
+#else
+	return texture(material.specularTex, texCoord).rgb;
+#endif
+}
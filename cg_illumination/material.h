@@ -10,6 +10,7 @@
 //#include<gtc\type_ptr.hpp>
 
 #include"Shader.h"
+#include"textureArray.h"
 
 class Material{
 private:
@@ -19,6 +20,11 @@ private:
 	GLint diffuseTex;
 	GLint specularTex;
 
+	// Optional layers in a texture array, used instead of bound textures by batched draws
+	TextureArray* textureArray;
+	GLint diffuseLayer;
+	GLint specularLayer;
+
 public:
 	Material(glm::vec3 ambient, glm::vec3 diffuse, glm::vec3 specular,
 		GLint diffuseTex, GLint specularTex){
@@ -27,10 +33,30 @@ public:
 		this->specular = specular;
 		this->diffuseTex = diffuseTex;
 		this->specularTex = specularTex;
+		this->textureArray = nullptr;
+		this->diffuseLayer = 0;
+		this->specularLayer = 0;
 	}
 
 	~Material(){}
 
+	//Accessors
+	inline glm::vec3 getAmbient() const{return this->ambient;}
+	inline glm::vec3 getDiffuse() const{return this->diffuse;}
+	inline glm::vec3 getSpecular() const{return this->specular;}
+	inline TextureArray* getTextureArray() const{return this->textureArray;}
+	inline GLint getDiffuseLayer() const{return this->diffuseLayer;}
+	inline GLint getSpecularLayer() const{return this->specularLayer;}
+
+	//Modifiers
+
+	// Both layers have to live in the same array
+	void setTextureLayers(TextureArray* textureArray, GLint diffuseLayer, GLint specularLayer){
+		this->textureArray = textureArray;
+		this->diffuseLayer = diffuseLayer;
+		this->specularLayer = specularLayer;
+	}
+
 	//Function
 	void sendToShader(Shader& program){
 		program.setVec3f(this->ambient, "material.ambient");
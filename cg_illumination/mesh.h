@@ -2,6 +2,8 @@
 
 #include <iostream>
 #include <vector>
+#include <algorithm>
+#include <numeric>
 #include <glm/gtx/rotate_vector.hpp>
 #include <map>
 //#include <glm/glm.hpp>
@@ -12,6 +14,10 @@
 #include "shader.h"
 #include "texture.h"
 #include "Material.h"
+#include "geometryHeap.h"
+#include "transformBatch.h"
+#include "meshSimplifier.h"
+#include "clusterBuilder.h"
 
 class Mesh{
 private:
@@ -24,6 +30,10 @@ private:
 	GLuint VBO;
 	GLuint EBO;
 
+	// Range in a shared GeometryHeap, only valid if heap is set
+	GeometryHeap* heap;
+	GeometryAllocation allocation;
+
 	glm::vec3 position;
 	glm::vec3 origin;
 	glm::vec3 rotationAroundOrigin;
@@ -32,6 +42,57 @@ private:
 
 	glm::mat4 model;
 
+	// Local bounding sphere, center in xyz and radius in w, and axis aligned bounding box
+	glm::vec4 boundingSphere;
+	glm::vec3 boundingBoxMin;
+	glm::vec3 boundingBoxMax;
+
+	// Indices are quartic Bézier patches of 25 control points (see patchFitter.h), drawn as GL_PATCHES
+	bool patches;
+
+	// Coarser versions of this mesh, lods[i] is level i + 1 and deviates about lodErrors[i] from it in model space.
+	// They are drawn with this mesh's transform when selected.
+	std::vector<Mesh*> lods;
+	std::vector<GLfloat> lodErrors;
+	unsigned lod;
+
+	// Ranges of the index buffer that ClusterCuller tests one by one, empty until buildClusters()
+	std::vector<Cluster> clusters;
+
+	inline const Mesh* selected() const{return this->lod > 0 ? this->lods[this->lod - 1] : this;}
+
+	void clearLods(){
+		for(auto*& i : this->lods){
+			delete i;
+		}
+		this->lods.clear();
+		this->lodErrors.clear();
+		this->lod = 0;
+	}
+
+	void computeBounds(){
+		if(this->nrOfVertices == 0){
+			this->boundingSphere = glm::vec4(0.f);
+			this->boundingBoxMin = glm::vec3(0.f);
+			this->boundingBoxMax = glm::vec3(0.f);
+			return;
+		}
+		glm::vec3 minimum = this->vertexArray[0].position;
+		glm::vec3 maximum = this->vertexArray[0].position;
+		for(unsigned i = 1; i < this->nrOfVertices; i++){
+			minimum = glm::min(minimum, this->vertexArray[i].position);
+			maximum = glm::max(maximum, this->vertexArray[i].position);
+		}
+		glm::vec3 center = (minimum + maximum) * 0.5f;
+		GLfloat radius = 0.f;
+		for(unsigned i = 0; i < this->nrOfVertices; i++){
+			radius = std::max(radius, glm::length(this->vertexArray[i].position - center));
+		}
+		this->boundingSphere = glm::vec4(center, radius);
+		this->boundingBoxMin = minimum;
+		this->boundingBoxMax = maximum;
+	}
+
 	void initVAO(){
 		//Create VAO
 		glGenVertexArrays(1, &this->VAO);
@@ -68,7 +129,11 @@ private:
 	}
 
 	void updateUniforms(Shader* shader){
+		DrawTransform transform;
+		computeDrawTransforms(shader->getViewProjection(), &this->model, &transform, 1);
 		shader->setMat4fv(this->model, "model");
+		shader->setMat4fv(transform.mvp, "mvp");
+		shader->setMat3fv(glm::mat3(transform.normalMatrix), "normalMatrix");
 	}
 
 	void updateModelMatrix(){
@@ -107,6 +172,10 @@ public:
 			this->indexArray[i] = indexArray[i];
 		}
 
+		this->patches = false;
+		this->lod = 0;
+		this->heap = nullptr;
+		this->computeBounds();
 		this->initVAO();
 		this->updateModelMatrix();
 	}
@@ -132,6 +201,10 @@ public:
 			this->indexArray[i] = primitive->getIndices()[i];
 		}
 
+		this->patches = false;
+		this->lod = 0;
+		this->heap = nullptr;
+		this->computeBounds();
 		this->initVAO();
 		this->updateModelMatrix();
 	}
@@ -155,8 +228,23 @@ public:
 			this->indexArray[i] = obj.indexArray[i];
 		}
 
+		this->patches = obj.patches;
+		this->lod = 0;
+		this->clusters = obj.clusters;
+		this->heap = nullptr;
+		this->computeBounds();
 		this->initVAO();
 		this->updateModelMatrix();
+
+		for(size_t i = 0; i < obj.lods.size(); i++){
+			this->lods.push_back(new Mesh(*obj.lods[i]));
+			this->lodErrors.push_back(obj.lodErrors[i]);
+		}
+		this->lod = obj.lod;
+
+		if(obj.heap){
+			this->attachToHeap(obj.heap);
+		}
 	}
 
 	Mesh(const char *path, glm::vec3 position = glm::vec3(0.f), glm::vec3 origin = glm::vec3(0.f), glm::vec3 rotation = glm::vec3(0.f),
@@ -168,6 +256,7 @@ public:
 		this->scale = scale;
 
 		std::vector<unsigned int> vertexIndices;
+		std::vector<unsigned int> patchIndices;
 		std::vector<glm::vec3> temp_vertices;
 
 		FILE * file = fopen(path, "r");
@@ -200,11 +289,49 @@ public:
 				vertexIndices.push_back(vertexIndex[0]);
 				vertexIndices.push_back(vertexIndex[1]);
 				vertexIndices.push_back(vertexIndex[2]);
+				// patches, 25 control points each
+			} else if(strcmp(lineHeader, "p") == 0){
+				for(int i = 0; i < 25; i++){
+					unsigned int patchIndex = 0;
+					if(fscanf(file, "%u", &patchIndex) != 1 || patchIndex == 0 || patchIndex > temp_vertices.size()){
+						std::cout << "ERROR::MESH::INVALID_PATCH: " << path << "\n";
+						patchIndex = 1;
+					}
+					patchIndices.push_back(patchIndex - 1);
+				}
+			} else {
+				// skip comments and anything else to the end of the line
+				fscanf(file, "%*[^\n]\n");
+			}
+		}
+		if(file != NULL){
+			fclose(file);
+		}
+
+		// Control points are kept as they are and indexed by the patches, normals come from the tessellation
+		if(!patchIndices.empty()){
+			this->nrOfVertices = temp_vertices.size();
+			this->nrOfIndices = patchIndices.size();
+			this->vertexArray = new Vertex[this->nrOfVertices];
+			for(unsigned i = 0; i < this->nrOfVertices; i++){
+				Vertex vertex = {temp_vertices[i], glm::vec4(1.f, 0.f, 1.f, 1.f), glm::vec2(0.f), glm::vec3(0.f)};
+				this->vertexArray[i] = vertex;
 			}
+			this->indexArray = new GLuint[this->nrOfIndices];
+			std::copy(patchIndices.begin(), patchIndices.end(), this->indexArray);
+
+			this->patches = true;
+			this->lod = 0;
+			this->heap = nullptr;
+			this->computeBounds();
+			this->initVAO();
+			this->updateModelMatrix();
+			return;
 		}
 
 		this->nrOfVertices = vertexIndices.size();
 		this->nrOfIndices = 0;
+		this->indexArray = nullptr;
 
 		// compute normals
 		glm::vec3 *unit_norm = new glm::vec3[this->nrOfVertices];
@@ -242,11 +369,17 @@ public:
 			this->vertexArray[i] = vertex;
 		}
 
+		this->patches = false;
+		this->lod = 0;
+		this->heap = nullptr;
+		this->computeBounds();
 		this->initVAO();
 		this->updateModelMatrix();
 	}
 
 	~Mesh(){
+		this->clearLods();
+
 		glDeleteVertexArrays(1, &this->VAO);
 		glDeleteBuffers(1, &this->VBO);
 
@@ -254,11 +387,57 @@ public:
 			glDeleteBuffers(1, &this->EBO);
 		}
 
+		if(this->heap){
+			this->heap->release(this->allocation);
+		}
+
 		delete[] this->vertexArray;
 		delete[] this->indexArray;
 	}
 
 	//Accessors
+	inline const Vertex* getVertices() const{return this->vertexArray;}
+	inline unsigned getNrOfVertices() const{return this->nrOfVertices;}
+	inline const GLuint* getIndices() const{return this->indexArray;}
+	inline unsigned getNrOfIndices() const{return this->nrOfIndices;}
+	inline const glm::vec4& getBoundingSphere() const{return this->boundingSphere;}
+	inline const glm::vec3& getBoundingBoxMin() const{return this->boundingBoxMin;}
+	inline const glm::vec3& getBoundingBoxMax() const{return this->boundingBoxMax;}
+	inline bool hasPatches() const{return this->patches;}
+	inline unsigned getNrOfLods() const{return (unsigned)this->lods.size() + 1;}
+	inline unsigned getLod() const{return this->lod;}
+	inline GLfloat getLodError(unsigned level) const{return level == 0 ? 0.f : this->lodErrors[level - 1];}
+
+	// Triangles drawn at the selected level
+	unsigned getNrOfTriangles() const{
+		const Mesh* mesh = this->selected();
+		return (mesh->nrOfIndices > 0 ? mesh->nrOfIndices : mesh->nrOfVertices) / 3;
+	}
+
+	// Clusters of the selected level
+	inline const std::vector<Cluster>& getClusters() const{return this->selected()->clusters;}
+
+	// Bounding sphere in world space, the radius grows with the largest scale axis
+	glm::vec4 getWorldBoundingSphere(){
+		glm::mat4 model = this->getModelMatrix();
+		glm::vec3 center = glm::vec3(model * glm::vec4(glm::vec3(this->boundingSphere), 1.f));
+		GLfloat scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+		return glm::vec4(center, this->boundingSphere.w * scale);
+	}
+
+	// Axis aligned box around the transformed local box (Arvo): the center is transformed, the half extent by the
+	// absolute values of the rotation and scale
+	void getWorldBoundingBox(glm::vec3& minimum, glm::vec3& maximum){
+		glm::mat4 model = this->getModelMatrix();
+		glm::vec3 center = glm::vec3(model * glm::vec4((this->boundingBoxMin + this->boundingBoxMax) * 0.5f, 1.f));
+		glm::vec3 extent = (this->boundingBoxMax - this->boundingBoxMin) * 0.5f;
+		glm::vec3 worldExtent(0.f);
+		for(int i = 0; i < 3; i++){
+			worldExtent += glm::abs(glm::vec3(model[i])) * extent[i];
+		}
+		minimum = center - worldExtent;
+		maximum = center + worldExtent;
+	}
 
 	//Modifiers
 	void setPosition(const glm::vec3 position){
@@ -270,9 +449,14 @@ public:
 	}
 
 	glm::mat4 getModelMatrix(){
+		this->updateModelMatrix();
 		return this->model;
 	}
 
+	GeometryHeap* getHeap(){
+		return this->heap;
+	}
+
 	void setOrigin(const glm::vec3 origin){
 		this->origin = origin;
 	}
@@ -289,6 +473,10 @@ public:
 		this->scale = scale;
 	}
 
+	void setLod(unsigned level){
+		this->lod = std::min(level, (unsigned)this->lods.size());
+	}
+
 	//Functions
 
 	void move(const glm::vec3 position){
@@ -311,13 +499,139 @@ public:
 
 	}
 
-	void render(Shader* shader, int mode = GL_TRIANGLES, int patchsize = 25){
-		//Update uniforms
-		this->updateModelMatrix();
-		this->updateUniforms(shader);
+	// Copy the geometry into a shared heap so it can be drawn with glMultiDrawElementsIndirect
+	void attachToHeap(GeometryHeap* heap){
+		if(this->heap){
+			this->heap->release(this->allocation);
+		}
+		this->heap = heap;
 
-		shader->Use();
+		if(this->nrOfIndices > 0){
+			this->allocation = heap->allocate(this->vertexArray, this->nrOfVertices, this->indexArray, this->nrOfIndices);
+		}else{
+			// Indirect draws are always indexed, so number unindexed vertices in order
+			std::vector<GLuint> indices(this->nrOfVertices);
+			for(GLuint i = 0; i < this->nrOfVertices; i++){
+				indices[i] = i;
+			}
+			this->allocation = heap->allocate(this->vertexArray, this->nrOfVertices, indices.data(), this->nrOfVertices);
+		}
+
+		for(auto& i : this->lods){
+			i->attachToHeap(heap);
+		}
+	}
+
+	// Build levels of about ratio times the triangles of the previous one with MeshSimplifier, until minTriangles
+	// would be undercut or nothing more can be removed. Each level is simplified from the previous one, its error
+	// adds up the estimated distances of the steps.
+	void generateLods(unsigned levels = 4, float ratio = 0.5f, unsigned minTriangles = 64){
+		this->clearLods();
+		if(this->patches){
+			std::cout << "ERROR::MESH::NO_LODS_FOR_PATCHES" << "\n";
+			return;
+		}
+		std::vector<Vertex> vertices(this->vertexArray, this->vertexArray + this->nrOfVertices);
+		std::vector<GLuint> indices(this->indexArray, this->indexArray + this->nrOfIndices);
+		size_t triangles = (this->nrOfIndices > 0 ? this->nrOfIndices : this->nrOfVertices) / 3;
+		GLfloat error = 0.f;
+		for(unsigned level = 0; level < levels; level++){
+			size_t target = (size_t)(triangles * ratio);
+			if(target < minTriangles){
+				break;
+			}
+			error += (GLfloat)MeshSimplifier::simplify(vertices, indices, target);
+			if(indices.size() / 3 >= triangles){
+				break;
+			}
+			triangles = indices.size() / 3;
+			this->lods.push_back(new Mesh(vertices.data(), (unsigned)vertices.size(), indices.data(), (unsigned)indices.size()));
+			this->lodErrors.push_back(error);
+		}
+
+		if(this->heap){
+			for(auto& i : this->lods){
+				i->attachToHeap(this->heap);
+			}
+		}
+	}
+
+	// Split this mesh and all its levels into clusters (see ClusterBuilder), call it after generateLods.
+	// The triangles are reordered so every cluster is a range of the index buffer, unindexed meshes get an index buffer.
+	void buildClusters(size_t maxTriangles = 128){
+		for(auto& i : this->lods){
+			i->buildClusters(maxTriangles);
+		}
+		if(this->patches){
+			std::cout << "ERROR::MESH::NO_CLUSTERS_FOR_PATCHES" << "\n";
+			return;
+		}
 
+		if(this->nrOfIndices == 0){
+			this->nrOfIndices = this->nrOfVertices;
+			delete[] this->indexArray;
+			this->indexArray = new GLuint[this->nrOfIndices];
+			std::iota(this->indexArray, this->indexArray + this->nrOfIndices, 0);
+		}else{
+			glDeleteBuffers(1, &this->EBO);
+		}
+		this->clusters = ClusterBuilder::build(this->vertexArray, this->indexArray, this->nrOfIndices, maxTriangles);
+
+		glDeleteVertexArrays(1, &this->VAO);
+		glDeleteBuffers(1, &this->VBO);
+		this->initVAO();
+
+		if(this->heap){
+			this->heap->release(this->allocation);
+			this->allocation = this->heap->allocate(this->vertexArray, this->nrOfVertices, this->indexArray, this->nrOfIndices);
+		}
+	}
+
+	// Pick the coarsest level whose error projects to at most pixelError pixels on a viewport of viewportHeight
+	// pixels, measured at the point of the bounding sphere closest to the camera
+	unsigned selectLod(const glm::vec3& cameraPosition, const glm::mat4& projection, GLfloat viewportHeight, GLfloat pixelError = 1.f){
+		glm::vec4 sphere = this->getWorldBoundingSphere();
+		GLfloat scale = this->boundingSphere.w > 0.f ? sphere.w / this->boundingSphere.w : 1.f;
+		GLfloat distance = std::max(glm::distance(cameraPosition, glm::vec3(sphere)) - sphere.w, 1e-3f);
+		GLfloat pixelsPerUnit = projection[1][1] * viewportHeight * 0.5f / distance;
+
+		this->lod = 0;
+		while(this->lod < this->lods.size() && this->lodErrors[this->lod] * scale * pixelsPerUnit <= pixelError){
+			this->lod++;
+		}
+		return this->lod;
+	}
+
+	// Draw of the clusters first to first + count - 1 of the selected level, they are consecutive in the index buffer
+	DrawElementsIndirectCommand getClusterDrawCommand(size_t first, size_t count, GLuint baseInstance = 0) const{
+		const Mesh* mesh = this->selected();
+		const Cluster& last = mesh->clusters[first + count - 1];
+		DrawElementsIndirectCommand command = {
+			last.firstIndex + last.nrOfIndices - mesh->clusters[first].firstIndex,
+			1,
+			mesh->allocation.firstIndex + mesh->clusters[first].firstIndex,
+			mesh->allocation.baseVertex,
+			baseInstance
+		};
+		return command;
+	}
+
+	DrawElementsIndirectCommand getDrawCommand(GLuint baseInstance = 0){
+		if(this->lod > 0){
+			return this->lods[this->lod - 1]->getDrawCommand(baseInstance);
+		}
+		DrawElementsIndirectCommand command = {
+			this->allocation.nrOfIndices,
+			1,
+			this->allocation.firstIndex,
+			this->allocation.baseVertex,
+			baseInstance
+		};
+		return command;
+	}
+
+	// Issue the draw with whatever program is bound, uniforms are left to the caller
+	void draw(int mode = GL_TRIANGLES, int patchsize = 25){
 		//Bind VAO
 		glBindVertexArray(this->VAO);
 
@@ -332,6 +646,47 @@ public:
 			glDrawElements(mode, this->nrOfIndices, GL_UNSIGNED_INT, 0);
 		}
 
+		glBindVertexArray(0);
+	}
+
+	void render(Shader* shader, int mode = GL_TRIANGLES, int patchsize = 25){
+		//Update uniforms
+		this->updateModelMatrix();
+		this->updateUniforms(shader);
+
+		shader->Use();
+
+		// The selected level shares the transform of this mesh
+		if(this->lod > 0){
+			this->lods[this->lod - 1]->draw(mode, patchsize);
+		}else{
+			this->draw(mode, patchsize);
+		}
+
+		//Cleanup
+		glUseProgram(0);
+		glActiveTexture(0);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	// Draw several copies in one call, per instance data comes from a buffer indexed by gl_InstanceID
+	void renderInstanced(Shader* shader, GLsizei instances, int mode = GL_TRIANGLES){
+		//Update uniforms
+		this->updateModelMatrix();
+		this->updateUniforms(shader);
+
+		shader->Use();
+
+		//Bind VAO
+		glBindVertexArray(this->VAO);
+
+		//RENDER
+		if(this->nrOfIndices == 0){
+			glDrawArraysInstanced(mode, 0, this->nrOfVertices, instances);
+		}else{
+			glDrawElementsInstanced(mode, this->nrOfIndices, GL_UNSIGNED_INT, 0, instances);
+		}
+
 		//Cleanup
 		glBindVertexArray(0);
 		glUseProgram(0);
@@ -0,0 +1,564 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <queue>
+#include <map>
+#include <tuple>
+#include <algorithm>
+#include <numeric>
+#include <thread>
+#include <limits>
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+#include <glad/glad.h>
+
+#include "vertex.h"
+
+// Quadric error metric of a vertex (Garland and Heckbert): sum of squared distances to the planes of its
+// triangles, stored as the upper half of a symmetric 4x4 matrix
+struct Quadric{
+	double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+
+	Quadric(){
+		a2 = ab = ac = ad = b2 = bc = bd = c2 = cd = d2 = 0.0;
+	}
+
+	// Plane ax + by + cz + d = 0 with unit normal, scaled by weight
+	Quadric(double a, double b, double c, double d, double weight){
+		a2 = a * a * weight; ab = a * b * weight; ac = a * c * weight; ad = a * d * weight;
+		b2 = b * b * weight; bc = b * c * weight; bd = b * d * weight;
+		c2 = c * c * weight; cd = c * d * weight;
+		d2 = d * d * weight;
+	}
+
+	Quadric& operator+=(const Quadric& q){
+		a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+		b2 += q.b2; bc += q.bc; bd += q.bd;
+		c2 += q.c2; cd += q.cd;
+		d2 += q.d2;
+		return *this;
+	}
+
+	double error(const glm::dvec3& p) const{
+		return a2 * p.x * p.x + 2.0 * ab * p.x * p.y + 2.0 * ac * p.x * p.z + 2.0 * ad * p.x
+			+ b2 * p.y * p.y + 2.0 * bc * p.y * p.z + 2.0 * bd * p.y
+			+ c2 * p.z * p.z + 2.0 * cd * p.z
+			+ d2;
+	}
+
+	// Point of least error, false if the quadric is (nearly) singular, e.g. on a flat region
+	bool minimum(glm::dvec3& p) const{
+		double det = a2 * (b2 * c2 - bc * bc) - ab * (ab * c2 - bc * ac) + ac * (ab * bc - b2 * ac);
+		double scale = std::max(std::abs(a2), std::max(std::abs(b2), std::abs(c2)));
+		if(std::abs(det) <= 1e-12 * scale * scale * scale || scale == 0.0){
+			return false;
+		}
+		// Cramer's rule on A p = -b
+		double inv = 1.0 / det;
+		p.x = -inv * (ad * (b2 * c2 - bc * bc) - ab * (bd * c2 - bc * cd) + ac * (bd * bc - b2 * cd));
+		p.y = -inv * (a2 * (bd * c2 - cd * bc) - ad * (ab * c2 - bc * ac) + ac * (ab * cd - bd * ac));
+		p.z = -inv * (a2 * (b2 * cd - bc * bd) - ab * (ab * cd - bd * ac) + ad * (ab * bc - b2 * ac));
+		return true;
+	}
+};
+
+// Simplifies indexed triangle meshes by collapsing the edge of least quadric error first.
+// Collapses that would change the topology (link condition), flip a triangle or move the boundary are skipped.
+// Vertex attributes (normal, texture coordinate, color) are interpolated along the collapsed edge and their change,
+// weighted by the area around the endpoints, is added to the error, so seams and creases go last.
+// Large meshes are cut into slabs that are simplified on separate threads with their cut edges kept in place,
+// a final pass over the joined mesh then simplifies the cuts with the quadrics gathered so far.
+class MeshSimplifier{
+private:
+	struct Collapse{
+		double error;
+		double distance;
+		GLuint v0;
+		GLuint v1;
+		unsigned stamp0;
+		unsigned stamp1;
+		glm::dvec3 position;
+		double t;                                  // Attributes of v0 + t (v1 - v0)
+
+		bool operator<(const Collapse& other) const{
+			return this->error > other.error;
+		}
+	};
+
+	// Geometry between the passes, quadrics and areas are carried over so the final pass knows the removed detail
+	struct Part{
+		std::vector<glm::dvec3> positions;
+		std::vector<float> attributes;
+		std::vector<GLuint> indices;
+		std::vector<Quadric> quadrics;
+		std::vector<double> areas;
+		std::vector<GLuint> origin;                // Index of every vertex in the mesh the part was cut from
+		size_t targetTriangles;
+		double distance;
+	};
+
+	static const GLuint REMOVED = 0xFFFFFFFF;
+	static const size_t MIN_REGION_TRIANGLES = 8192;
+
+	size_t attributeSize;
+	double attributeWeight;                        // Turns squared attribute differences into squared distances
+	std::vector<glm::dvec3> positions;
+	std::vector<float> attributes;                 // attributeSize per vertex
+	std::vector<GLuint> triangles;                 // 3 per triangle, -1 marks removed triangles
+	std::vector<std::vector<GLuint>> vertexTriangles;  // Triangles using a vertex
+	std::vector<Quadric> quadrics;
+	std::vector<double> areas;                     // Sum of the quadric weights, the error per area is a squared distance
+	std::vector<unsigned> stamps;                  // Bumped whenever a vertex changes, older collapses are stale
+	std::vector<bool> boundary;
+	std::vector<bool> removed;
+	std::priority_queue<Collapse> heap;
+	size_t nrOfTriangles;
+	double distance;                               // Largest distance estimate of the collapses done
+
+	MeshSimplifier(Part& part, size_t attributeSize, double attributeWeight){
+		size_t nrOfVertices = part.positions.size();
+		this->attributeSize = attributeSize;
+		this->attributeWeight = attributeWeight;
+		this->positions.swap(part.positions);
+		this->attributes.swap(part.attributes);
+		this->triangles.swap(part.indices);
+		this->nrOfTriangles = this->triangles.size() / 3;
+		this->vertexTriangles.resize(nrOfVertices);
+		this->stamps.assign(nrOfVertices, 0);
+		this->boundary.assign(nrOfVertices, false);
+		this->removed.assign(nrOfVertices, false);
+		this->distance = 0.0;
+
+		// Plane quadrics weighted by area, unless they come from an earlier pass
+		bool computeQuadrics = part.quadrics.empty();
+		if(computeQuadrics){
+			this->quadrics.resize(nrOfVertices);
+			this->areas.assign(nrOfVertices, 0.0);
+		}else{
+			this->quadrics.swap(part.quadrics);
+			this->areas.swap(part.areas);
+		}
+
+		// Edges used by one triangle mark the boundary
+		std::map<std::pair<GLuint, GLuint>, int> edges;
+		for(GLuint t = 0; t < this->nrOfTriangles; t++){
+			const GLuint* tri = &this->triangles[t * 3];
+			if(computeQuadrics){
+				glm::dvec3 normal = glm::cross(this->positions[tri[1]] - this->positions[tri[0]], this->positions[tri[2]] - this->positions[tri[0]]);
+				double area = glm::length(normal);
+				if(area > 0.0){
+					normal /= area;
+					Quadric q(normal.x, normal.y, normal.z, -glm::dot(normal, this->positions[tri[0]]), area * 0.5);
+					for(int i = 0; i < 3; i++){
+						this->quadrics[tri[i]] += q;
+						this->areas[tri[i]] += area * 0.5;
+					}
+				}
+			}
+			for(int i = 0; i < 3; i++){
+				this->vertexTriangles[tri[i]].push_back(t);
+				GLuint a = tri[i];
+				GLuint b = tri[(i + 1) % 3];
+				edges[std::make_pair(std::min(a, b), std::max(a, b))]++;
+			}
+		}
+		for(auto& i : edges){
+			if(i.second != 2){
+				this->boundary[i.first.first] = true;
+				this->boundary[i.first.second] = true;
+			}
+		}
+		for(auto& i : edges){
+			this->pushCollapse(i.first.first, i.first.second);
+		}
+	}
+
+	glm::dvec3 triangleNormal(GLuint t, GLuint moved, const glm::dvec3& position) const{
+		glm::dvec3 p[3];
+		for(int i = 0; i < 3; i++){
+			GLuint v = this->triangles[t * 3 + i];
+			p[i] = v == moved ? position : this->positions[v];
+		}
+		return glm::cross(p[1] - p[0], p[2] - p[0]);
+	}
+
+	void neighbours(GLuint v, std::vector<GLuint>& result) const{
+		result.clear();
+		for(GLuint t : this->vertexTriangles[v]){
+			for(int i = 0; i < 3; i++){
+				GLuint w = this->triangles[t * 3 + i];
+				if(w != v && std::find(result.begin(), result.end(), w) == result.end()){
+					result.push_back(w);
+				}
+			}
+		}
+	}
+
+	void pushCollapse(GLuint v0, GLuint v1){
+		if(this->boundary[v0] || this->boundary[v1]){
+			return;
+		}
+		Quadric q = this->quadrics[v0];
+		q += this->quadrics[v1];
+
+		Collapse collapse;
+		collapse.v0 = v0;
+		collapse.v1 = v1;
+		collapse.stamp0 = this->stamps[v0];
+		collapse.stamp1 = this->stamps[v1];
+		if(!q.minimum(collapse.position)){
+			// Pick the best of the endpoints and the midpoint
+			glm::dvec3 candidates[3] = {this->positions[v0], this->positions[v1], (this->positions[v0] + this->positions[v1]) * 0.5};
+			collapse.position = candidates[0];
+			for(int i = 1; i < 3; i++){
+				if(q.error(candidates[i]) < q.error(collapse.position)){
+					collapse.position = candidates[i];
+				}
+			}
+		}
+		double error = std::max(0.0, q.error(collapse.position));
+		double area = this->areas[v0] + this->areas[v1];
+		collapse.distance = area > 0.0 ? std::sqrt(error / area) : 0.0;
+
+		// The attributes are taken from where the new position lies along the edge, both endpoints change by their
+		// distance to it over their area
+		glm::dvec3 edge = this->positions[v1] - this->positions[v0];
+		double length2 = glm::dot(edge, edge);
+		collapse.t = length2 > 0.0 ? std::min(1.0, std::max(0.0, glm::dot(collapse.position - this->positions[v0], edge) / length2)) : 0.5;
+		double difference = 0.0;
+		for(size_t i = 0; i < this->attributeSize; i++){
+			double d = this->attributes[v1 * this->attributeSize + i] - this->attributes[v0 * this->attributeSize + i];
+			difference += d * d;
+		}
+		double t = collapse.t;
+		error += this->attributeWeight * difference * (t * t * this->areas[v0] + (1.0 - t) * (1.0 - t) * this->areas[v1]);
+
+		collapse.error = error;
+		this->heap.push(collapse);
+	}
+
+	// Manifold stays manifold if the only common neighbours are the opposite vertices of the edge's two triangles,
+	// and no other triangle around the edge may turn over
+	bool canCollapse(const Collapse& collapse) const{
+		GLuint v0 = collapse.v0;
+		GLuint v1 = collapse.v1;
+		std::vector<GLuint> n0;
+		std::vector<GLuint> n1;
+		this->neighbours(v0, n0);
+		this->neighbours(v1, n1);
+		if(std::find(n0.begin(), n0.end(), v1) == n0.end()){
+			return false;
+		}
+		int shared = 0;
+		for(GLuint w : n0){
+			shared += std::find(n1.begin(), n1.end(), w) != n1.end() ? 1 : 0;
+		}
+		if(shared != 2){
+			return false;
+		}
+
+		GLuint ends[2] = {v0, v1};
+		for(GLuint v : ends){
+			for(GLuint t : this->vertexTriangles[v]){
+				const GLuint* tri = &this->triangles[t * 3];
+				bool hasBoth = (tri[0] == v0 || tri[1] == v0 || tri[2] == v0) && (tri[0] == v1 || tri[1] == v1 || tri[2] == v1);
+				if(hasBoth){
+					continue;
+				}
+				glm::dvec3 before = this->triangleNormal(t, REMOVED, glm::dvec3(0.0));
+				glm::dvec3 after = this->triangleNormal(t, v, collapse.position);
+				double lengthBefore = glm::length(before);
+				double lengthAfter = glm::length(after);
+				if(lengthAfter <= 1e-12 * (lengthBefore + 1e-30) || glm::dot(before, after) < 0.2 * lengthBefore * lengthAfter){
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	void collapse(const Collapse& collapse){
+		GLuint v0 = collapse.v0;
+		GLuint v1 = collapse.v1;
+
+		for(GLuint t : this->vertexTriangles[v1]){
+			GLuint* tri = &this->triangles[t * 3];
+			if(tri[0] == v0 || tri[1] == v0 || tri[2] == v0){
+				// Degenerates, remove it from its other vertices
+				for(int i = 0; i < 3; i++){
+					if(tri[i] != v1){
+						auto& list = this->vertexTriangles[tri[i]];
+						list.erase(std::remove(list.begin(), list.end(), t), list.end());
+					}
+					tri[i] = REMOVED;
+				}
+				this->nrOfTriangles--;
+			}else{
+				for(int i = 0; i < 3; i++){
+					if(tri[i] == v1){
+						tri[i] = v0;
+					}
+				}
+				this->vertexTriangles[v0].push_back(t);
+			}
+		}
+		this->vertexTriangles[v1].clear();
+		this->removed[v1] = true;
+
+		for(size_t i = 0; i < this->attributeSize; i++){
+			float& a0 = this->attributes[v0 * this->attributeSize + i];
+			a0 += (float)collapse.t * (this->attributes[v1 * this->attributeSize + i] - a0);
+		}
+		this->positions[v0] = collapse.position;
+		this->quadrics[v0] += this->quadrics[v1];
+		this->areas[v0] += this->areas[v1];
+		this->stamps[v0]++;
+		this->stamps[v1]++;
+		this->distance = std::max(this->distance, collapse.distance);
+
+		// Only the edges around v0 changed, the others keep their queued collapses
+		std::vector<GLuint> n0;
+		this->neighbours(v0, n0);
+		for(GLuint w : n0){
+			this->pushCollapse(v0, w);
+		}
+	}
+
+	void run(size_t targetTriangles, double maxError){
+		while(this->nrOfTriangles > targetTriangles && !this->heap.empty()){
+			Collapse next = this->heap.top();
+			this->heap.pop();
+			if(this->removed[next.v0] || this->removed[next.v1] ||
+				next.stamp0 != this->stamps[next.v0] || next.stamp1 != this->stamps[next.v1]){
+				continue;
+			}
+			if(next.distance > maxError){
+				continue;
+			}
+			if(this->canCollapse(next)){
+				this->collapse(next);
+			}
+		}
+	}
+
+	// Compact the remaining vertices and triangles into part
+	void output(Part& part) const{
+		std::vector<GLuint> remap(this->positions.size(), REMOVED);
+		part.positions.clear();
+		part.attributes.clear();
+		part.indices.clear();
+		part.quadrics.clear();
+		part.areas.clear();
+		std::vector<GLuint> origin;
+		for(size_t i = 0; i < this->triangles.size(); i++){
+			GLuint v = this->triangles[i];
+			if(v == REMOVED){
+				continue;
+			}
+			if(remap[v] == REMOVED){
+				remap[v] = (GLuint)part.positions.size();
+				part.positions.push_back(this->positions[v]);
+				part.attributes.insert(part.attributes.end(), this->attributes.begin() + v * this->attributeSize,
+					this->attributes.begin() + (v + 1) * this->attributeSize);
+				part.quadrics.push_back(this->quadrics[v]);
+				part.areas.push_back(this->areas[v]);
+				origin.push_back(part.origin.empty() ? v : part.origin[v]);
+			}
+			part.indices.push_back(remap[v]);
+		}
+		part.origin.swap(origin);
+		part.distance = std::max(part.distance, this->distance);
+	}
+
+	// Cut mesh into slabs of equal triangle count along its longest axis and simplify them in parallel.
+	// Vertices used by several slabs lie on cut edges, which are boundary in every slab and stay where they are.
+	static void simplifyRegions(Part& mesh, size_t attributeSize, double attributeWeight, double maxError, size_t nrOfRegions){
+		size_t nrOfTriangles = mesh.indices.size() / 3;
+		glm::dvec3 minimum = mesh.positions[0];
+		glm::dvec3 maximum = mesh.positions[0];
+		for(auto& i : mesh.positions){
+			minimum = glm::min(minimum, i);
+			maximum = glm::max(maximum, i);
+		}
+		glm::dvec3 extent = maximum - minimum;
+		int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+		std::vector<double> keys(nrOfTriangles);
+		for(size_t t = 0; t < nrOfTriangles; t++){
+			keys[t] = mesh.positions[mesh.indices[t * 3]][axis] + mesh.positions[mesh.indices[t * 3 + 1]][axis] + mesh.positions[mesh.indices[t * 3 + 2]][axis];
+		}
+		std::vector<GLuint> order(nrOfTriangles);
+		std::iota(order.begin(), order.end(), 0);
+		std::sort(order.begin(), order.end(), [&keys](GLuint a, GLuint b){return keys[a] < keys[b];});
+
+		// -2 marks vertices shared by several regions
+		std::vector<int> regionOf(mesh.positions.size(), -1);
+		std::vector<Part> regions(nrOfRegions);
+		for(size_t r = 0; r < nrOfRegions; r++){
+			size_t first = nrOfTriangles * r / nrOfRegions;
+			size_t last = nrOfTriangles * (r + 1) / nrOfRegions;
+			for(size_t i = first; i < last; i++){
+				for(int j = 0; j < 3; j++){
+					int& region = regionOf[mesh.indices[order[i] * 3 + j]];
+					region = region == -1 || region == (int)r ? (int)r : -2;
+				}
+			}
+		}
+
+		auto worker = [&](size_t r){
+			Part& region = regions[r];
+			size_t first = nrOfTriangles * r / nrOfRegions;
+			size_t last = nrOfTriangles * (r + 1) / nrOfRegions;
+			std::vector<GLuint> local(mesh.positions.size(), REMOVED);
+			for(size_t i = first; i < last; i++){
+				for(int j = 0; j < 3; j++){
+					GLuint v = mesh.indices[order[i] * 3 + j];
+					if(local[v] == REMOVED){
+						local[v] = (GLuint)region.positions.size();
+						region.positions.push_back(mesh.positions[v]);
+						region.attributes.insert(region.attributes.end(), mesh.attributes.begin() + v * attributeSize,
+							mesh.attributes.begin() + (v + 1) * attributeSize);
+						region.origin.push_back(v);
+					}
+					region.indices.push_back(local[v]);
+				}
+			}
+			region.distance = 0.0;
+			MeshSimplifier simplifier(region, attributeSize, attributeWeight);
+			// Regions only take the bulk off, the locked cuts would force poor collapses next to them if they went
+			// further. The final pass goes on from there.
+			simplifier.run(std::max(2 * mesh.targetTriangles * (last - first) / nrOfTriangles, (last - first) / 8), maxError);
+			simplifier.output(region);
+		};
+		std::vector<std::thread> threads;
+		for(size_t r = 1; r < nrOfRegions; r++){
+			threads.push_back(std::thread(worker, r));
+		}
+		worker(0);
+		for(auto& i : threads){
+			i.join();
+		}
+
+		// Join the regions, shared vertices get the sum of the quadrics each region gathered from its triangles
+		std::vector<GLuint> shared(mesh.positions.size(), REMOVED);
+		Part joined;
+		joined.targetTriangles = mesh.targetTriangles;
+		joined.distance = mesh.distance;
+		for(auto& region : regions){
+			std::vector<GLuint> remap(region.positions.size());
+			for(size_t i = 0; i < region.positions.size(); i++){
+				GLuint v = region.origin[i];
+				if(regionOf[v] == -2 && shared[v] != REMOVED){
+					remap[i] = shared[v];
+					joined.quadrics[shared[v]] += region.quadrics[i];
+					joined.areas[shared[v]] += region.areas[i];
+					continue;
+				}
+				remap[i] = (GLuint)joined.positions.size();
+				if(regionOf[v] == -2){
+					shared[v] = remap[i];
+				}
+				joined.positions.push_back(region.positions[i]);
+				joined.attributes.insert(joined.attributes.end(), region.attributes.begin() + i * attributeSize,
+					region.attributes.begin() + (i + 1) * attributeSize);
+				joined.quadrics.push_back(region.quadrics[i]);
+				joined.areas.push_back(region.areas[i]);
+			}
+			for(GLuint i : region.indices){
+				joined.indices.push_back(remap[i]);
+			}
+			joined.distance = std::max(joined.distance, region.distance);
+		}
+		mesh = joined;
+	}
+
+	// Simplify mesh to mesh.targetTriangles, on up to nrOfThreads threads (0 uses all cores)
+	static void simplify(Part& mesh, size_t attributeSize, double attributeWeight, double maxError, unsigned nrOfThreads){
+		mesh.distance = 0.0;
+		if(mesh.indices.empty()){
+			return;
+		}
+		if(nrOfThreads == 0){
+			nrOfThreads = std::thread::hardware_concurrency();
+		}
+		size_t nrOfRegions = std::min<size_t>(nrOfThreads, mesh.indices.size() / 3 / MIN_REGION_TRIANGLES);
+		if(nrOfRegions > 1){
+			simplifyRegions(mesh, attributeSize, attributeWeight, maxError, nrOfRegions);
+		}
+		MeshSimplifier simplifier(mesh, attributeSize, attributeWeight);
+		simplifier.run(mesh.targetTriangles, maxError);
+		simplifier.output(mesh);
+	}
+
+public:
+	// Collapse edges until at most targetTriangles remain, no collapse is allowed any more or every remaining one would
+	// move the surface by more than maxError. positions and indices are replaced by the result.
+	// Returns the estimated distance of the result to the original surface.
+	static double simplify(std::vector<glm::vec3>& positions, std::vector<GLuint>& indices, size_t targetTriangles,
+		double maxError = std::numeric_limits<double>::max(), unsigned nrOfThreads = 0){
+		Part mesh;
+		for(auto& i : positions){
+			mesh.positions.push_back(glm::dvec3(i));
+		}
+		mesh.indices = indices;
+		mesh.targetTriangles = targetTriangles;
+		simplify(mesh, 0, 0.0, maxError, nrOfThreads);
+
+		positions.clear();
+		for(auto& i : mesh.positions){
+			positions.push_back(glm::vec3(i));
+		}
+		indices.swap(mesh.indices);
+		return mesh.distance;
+	}
+
+	// Same for full vertices, empty indices read vertices as a list of triangles. Vertices with equal attributes are
+	// welded first, so only real attribute seams stay split (and in place). attributeWeight scales the squared attribute differences
+	// against squared distances relative to the bounding radius.
+	static double simplify(std::vector<Vertex>& vertices, std::vector<GLuint>& indices, size_t targetTriangles,
+		double maxError = std::numeric_limits<double>::max(), float attributeWeight = 0.01f, unsigned nrOfThreads = 0){
+		const size_t attributeSize = 9;
+		typedef std::tuple<float, float, float, float, float, float, float, float, float, float, float, float> Key;
+		std::map<Key, GLuint> welded;
+		Part mesh;
+		glm::vec3 minimum = vertices.empty() ? glm::vec3(0.f) : vertices[0].position;
+		glm::vec3 maximum = minimum;
+		if(indices.empty()){
+			indices.resize(vertices.size());
+			std::iota(indices.begin(), indices.end(), 0);
+		}
+		for(GLuint i : indices){
+			const Vertex& v = vertices[i];
+			Key key(v.position.x, v.position.y, v.position.z, v.normal.x, v.normal.y, v.normal.z,
+				v.texcoord.x, v.texcoord.y, v.color.r, v.color.g, v.color.b, v.color.a);
+			auto it = welded.find(key);
+			if(it == welded.end()){
+				it = welded.insert(std::make_pair(key, (GLuint)mesh.positions.size())).first;
+				mesh.positions.push_back(glm::dvec3(v.position));
+				float attributes[attributeSize] = {v.normal.x, v.normal.y, v.normal.z, v.texcoord.x, v.texcoord.y,
+					v.color.r, v.color.g, v.color.b, v.color.a};
+				mesh.attributes.insert(mesh.attributes.end(), attributes, attributes + attributeSize);
+				minimum = glm::min(minimum, v.position);
+				maximum = glm::max(maximum, v.position);
+			}
+			mesh.indices.push_back(it->second);
+		}
+		mesh.targetTriangles = targetTriangles;
+		double radius = glm::length(glm::dvec3(maximum - minimum)) * 0.5;
+		simplify(mesh, attributeSize, attributeWeight * radius * radius, maxError, nrOfThreads);
+
+		vertices.resize(mesh.positions.size());
+		for(size_t i = 0; i < mesh.positions.size(); i++){
+			const float* a = &mesh.attributes[i * attributeSize];
+			glm::vec3 normal(a[0], a[1], a[2]);
+			float length = glm::length(normal);
+			Vertex vertex = {glm::vec3(mesh.positions[i]), glm::vec4(a[5], a[6], a[7], a[8]), glm::vec2(a[3], a[4]),
+				length > 0.f ? normal / length : normal};
+			vertices[i] = vertex;
+		}
+		indices.swap(mesh.indices);
+		return mesh.distance;
+	}
+};
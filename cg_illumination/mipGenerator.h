@@ -0,0 +1,199 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+#include <xmmintrin.h>
+
+#include <glm/glm.hpp>
+
+// CPU mip chain generation for RGBA8 images.
+// Levels are filtered in floating point from the previous level, one pixel per SSE register. For sRGB color the
+// RGB channels are converted to linear light before filtering and back afterwards, so dark and bright texels
+// average the way the eye sees them instead of darkening. KAISER uses a separable Kaiser windowed sinc that keeps
+// distant surfaces sharper than the 2x2 BOX filter.
+class MipGenerator{
+public:
+	enum Filter{
+		GPU = 0,    // Leave it to glGenerateMipmap
+		BOX,
+		KAISER
+	};
+
+private:
+	static const int RADIUS = 2;            // Filter support in destination pixels
+	static const int ENCODE_TABLE_SIZE = 4096;
+
+	struct Tap{
+		int first;
+		std::vector<float> weights;
+	};
+
+	// sRGB conversion tables, built once on first use (thread safe as a function local static)
+	struct Tables{
+		float decode[256];
+		unsigned char encode[ENCODE_TABLE_SIZE];
+
+		Tables(){
+			for(int i = 0; i < 256; i++){
+				float c = i / 255.f;
+				this->decode[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			}
+			for(int i = 0; i < ENCODE_TABLE_SIZE; i++){
+				float c = i / (float)(ENCODE_TABLE_SIZE - 1);
+				float s = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.f / 2.4f) - 0.055f;
+				this->encode[i] = (unsigned char)(std::min(std::max(s, 0.f), 1.f) * 255.f + 0.5f);
+			}
+		}
+	};
+
+	static const Tables& tables(){
+		static Tables tables;
+		return tables;
+	}
+
+	static float bessel0(float x){
+		float sum = 1.f;
+		float term = 1.f;
+		for(int k = 1; k < 16; k++){
+			term *= (x / (2.f * k)) * (x / (2.f * k));
+			sum += term;
+		}
+		return sum;
+	}
+
+	static float kaiser(float distance){
+		const float alpha = 4.f;
+		const float pi = 3.14159265f;
+		float t = distance / RADIUS;
+		if(std::fabs(t) >= 1.f){
+			return 0.f;
+		}
+		float sinc = distance == 0.f ? 1.f : std::sin(pi * distance) / (pi * distance);
+		return sinc * bessel0(alpha * std::sqrt(1.f - t * t)) / bessel0(alpha);
+	}
+
+	// Normalized weights of every destination pixel along one axis
+	static std::vector<Tap> taps(int source, int destination, Filter filter){
+		std::vector<Tap> result(destination);
+		float scale = source / (float)destination;
+		for(int x = 0; x < destination; x++){
+			Tap& tap = result[x];
+			if(filter == BOX){
+				tap.first = std::min((int)(x * scale), source - 1);
+				int last = std::max(tap.first, std::min((int)((x + 1) * scale + 0.5f) - 1, source - 1));
+				tap.weights.assign(last - tap.first + 1, 1.f);
+			}else{
+				float center = (x + 0.5f) * scale;
+				tap.first = (int)std::floor(center - RADIUS * scale);
+				int last = (int)std::ceil(center + RADIUS * scale);
+				for(int i = tap.first; i <= last; i++){
+					tap.weights.push_back(kaiser((i + 0.5f - center) / scale));
+				}
+			}
+			float sum = 0.f;
+			for(float w : tap.weights){
+				sum += w;
+			}
+			for(float& w : tap.weights){
+				w /= sum;
+			}
+		}
+		return result;
+	}
+
+	// One separable filter pass, out of range source pixels are clamped to the edge
+	static void downsample(const std::vector<float>& source, int width, int height, std::vector<float>& destination, int w, int h, Filter filter){
+		std::vector<Tap> horizontal = taps(width, w, filter);
+		std::vector<Tap> vertical = taps(height, h, filter);
+
+		std::vector<float> rows((size_t)w * height * 4);
+		for(int y = 0; y < height; y++){
+			const float* row = &source[(size_t)y * width * 4];
+			for(int x = 0; x < w; x++){
+				const Tap& tap = horizontal[x];
+				__m128 sum = _mm_setzero_ps();
+				for(size_t i = 0; i < tap.weights.size(); i++){
+					int sx = std::min(std::max(tap.first + (int)i, 0), width - 1);
+					sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(&row[sx * 4]), _mm_set1_ps(tap.weights[i])));
+				}
+				_mm_storeu_ps(&rows[((size_t)y * w + x) * 4], sum);
+			}
+		}
+
+		destination.resize((size_t)w * h * 4);
+		__m128 zero = _mm_setzero_ps();
+		__m128 one = _mm_set1_ps(1.f);
+		for(int y = 0; y < h; y++){
+			const Tap& tap = vertical[y];
+			for(int x = 0; x < w; x++){
+				__m128 sum = _mm_setzero_ps();
+				for(size_t i = 0; i < tap.weights.size(); i++){
+					int sy = std::min(std::max(tap.first + (int)i, 0), height - 1);
+					sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(&rows[((size_t)sy * w + x) * 4]), _mm_set1_ps(tap.weights[i])));
+				}
+				// The negative lobes of the sinc can overshoot
+				sum = _mm_min_ps(_mm_max_ps(sum, zero), one);
+				_mm_storeu_ps(&destination[((size_t)y * w + x) * 4], sum);
+			}
+		}
+	}
+
+	static void decode(const unsigned char* image, size_t nrOfPixels, bool srgb, std::vector<float>& out){
+		const float* table = tables().decode;
+		out.resize(nrOfPixels * 4);
+		for(size_t i = 0; i < nrOfPixels * 4; i++){
+			out[i] = srgb && (i & 3) != 3 ? table[image[i]] : image[i] / 255.f;
+		}
+	}
+
+	static void encode(const std::vector<float>& level, bool srgb, std::vector<unsigned char>& out){
+		const unsigned char* table = tables().encode;
+		out.resize(level.size());
+		for(size_t i = 0; i < level.size(); i++){
+			if(srgb && (i & 3) != 3){
+				out[i] = table[(int)(level[i] * (ENCODE_TABLE_SIZE - 1) + 0.5f)];
+			}else{
+				out[i] = (unsigned char)(level[i] * 255.f + 0.5f);
+			}
+		}
+	}
+
+public:
+	static int getNrOfLevels(int width, int height){
+		int levels = 1;
+		while(width > 1 || height > 1){
+			width = std::max(1, width / 2);
+			height = std::max(1, height / 2);
+			levels++;
+		}
+		return levels;
+	}
+
+	// Every level from the full image down to 1x1, level 0 is a copy of image
+	static void generate(const unsigned char* image, int width, int height, Filter filter, bool srgb,
+		std::vector<std::vector<unsigned char>>& levels, std::vector<glm::ivec2>& sizes){
+		levels.assign(1, std::vector<unsigned char>(image, image + (size_t)width * height * 4));
+		sizes.assign(1, glm::ivec2(width, height));
+		if(filter == GPU){
+			filter = BOX;
+		}
+
+		std::vector<float> current;
+		std::vector<float> next;
+		decode(image, (size_t)width * height, srgb, current);
+		while(width > 1 || height > 1){
+			int w = std::max(1, width / 2);
+			int h = std::max(1, height / 2);
+			downsample(current, width, height, next, w, h, filter);
+			std::swap(current, next);
+			width = w;
+			height = h;
+
+			levels.push_back(std::vector<unsigned char>());
+			encode(current, srgb, levels.back());
+			sizes.push_back(glm::ivec2(width, height));
+		}
+	}
+};
@@ -5,6 +5,9 @@
 #include "shader.h"
 #include "Material.h"
 #include "particleSystem.h"
+#include "drawBatcher.h"
+#include "clusterCuller.h"
+#include "frustum.h"
 
 class Object{
 private:
@@ -14,16 +17,50 @@ private:
 	std::vector<Mesh*> meshes;
 	glm::vec3 origin;
 
+	// Result of the last cull, one flag per mesh
+	std::vector<glm::vec4> spheres;
+	std::vector<unsigned char> visible;
+	unsigned nrOfVisible;
+	unsigned nrOfCulled;
+
 	void updateUniforms(){
 
 	}
 
+	// World spheres of all meshes are tested four at a time, the survivors once more with their world boxes.
+	// Without a frustum every mesh is visible.
+	void cull(const Frustum* frustum){
+		size_t count = this->meshes.size();
+		this->visible.assign(count, 1);
+		if(frustum && count > 0){
+			this->spheres.resize(count);
+			for(size_t i = 0; i < count; i++){
+				this->spheres[i] = this->meshes[i]->getWorldBoundingSphere();
+			}
+			frustum->containsSpheres(this->spheres.data(), count, this->visible.data());
+			for(size_t i = 0; i < count; i++){
+				if(this->visible[i]){
+					glm::vec3 minimum, maximum;
+					this->meshes[i]->getWorldBoundingBox(minimum, maximum);
+					this->visible[i] = frustum->containsBox(minimum, maximum) ? 1 : 0;
+				}
+			}
+		}
+		this->nrOfVisible = 0;
+		for(auto i : this->visible){
+			this->nrOfVisible += i;
+		}
+		this->nrOfCulled = (unsigned)count - this->nrOfVisible;
+	}
+
 public:
 	Object(glm::vec3 origin, Material* material, Texture* orTexDif, Texture* orTexSpec, std::vector<Mesh*>& meshes){
 		this->origin = origin;
 		this->material = material;
 		this->overrideTextureDiffuse = orTexDif;
 		this->overrideTextureSpecular = orTexSpec;
+		this->nrOfVisible = 0;
+		this->nrOfCulled = 0;
 
 		for(auto* i : meshes){
 			this->meshes.push_back(new Mesh(*i));
@@ -41,6 +78,14 @@ public:
 		}
 	}
 
+	//Accessors
+	inline Material* getMaterial(){return this->material;}
+	inline Texture* getTextureDiffuse(){return this->overrideTextureDiffuse;}
+	inline Texture* getTextureSpecular(){return this->overrideTextureSpecular;}
+	inline std::vector<Mesh*>& getMeshes(){return this->meshes;}
+	inline unsigned getNrOfVisibleMeshes() const{return this->nrOfVisible;}
+	inline unsigned getNrOfCulledMeshes() const{return this->nrOfCulled;}
+
 	//Functions
 	glm::vec3 getPosition(){
 		std::vector<glm::vec3> positions;
@@ -86,7 +131,68 @@ public:
 
 	}
 
-	void render(Shader* shader){
+	// Build a chain of coarser levels for every mesh, see Mesh::generateLods
+	void generateLods(unsigned levels = 4, float ratio = 0.5f){
+		for(auto& i : this->meshes){
+			i->generateLods(levels, ratio);
+		}
+	}
+
+	// Pick the level of every mesh from its projected error, returns the number of triangles that will be drawn
+	unsigned selectLods(const glm::vec3& cameraPosition, const glm::mat4& projection, GLfloat viewportHeight, GLfloat pixelError = 1.f){
+		unsigned triangles = 0;
+		for(auto& i : this->meshes){
+			i->selectLod(cameraPosition, projection, viewportHeight, pixelError);
+			triangles += i->getNrOfTriangles();
+		}
+		return triangles;
+	}
+
+	// Split every mesh and its levels into clusters for a ClusterCuller
+	void buildClusters(size_t maxTriangles = 128){
+		for(auto& i : this->meshes){
+			i->buildClusters(maxTriangles);
+		}
+	}
+
+	// Move all meshes into a shared heap so they can be submitted to a DrawBatcher
+	void attachToHeap(GeometryHeap* heap){
+		for(auto& i : this->meshes){
+			i->attachToHeap(heap);
+		}
+	}
+
+	// Meshes outside frustum are left out
+	void submit(DrawBatcher* batcher, const Frustum* frustum = nullptr){
+		this->cull(frustum);
+		for(size_t m = 0; m < this->meshes.size(); m++){
+			if(!this->visible[m]){
+				continue;
+			}
+			Mesh* i = this->meshes[m];
+			DrawElementsIndirectCommand command = i->getDrawCommand();
+			if(this->material->getTextureArray()){
+				batcher->add(this->material, command, i->getModelMatrix());
+			}else{
+				batcher->add(this->material, this->overrideTextureDiffuse, this->overrideTextureSpecular, command, i->getModelMatrix());
+			}
+		}
+	}
+
+	// Only the visible clusters of the meshes reach the batcher when the culler is flushed
+	void submit(ClusterCuller* culler, const Frustum* frustum = nullptr){
+		this->cull(frustum);
+		for(size_t i = 0; i < this->meshes.size(); i++){
+			if(this->visible[i]){
+				culler->add(this->meshes[i], this->material, this->overrideTextureDiffuse, this->overrideTextureSpecular);
+			}
+		}
+	}
+
+	// Meshes outside frustum are skipped, getNrOfVisibleMeshes and getNrOfCulledMeshes tell how many
+	void render(Shader* shader, const Frustum* frustum = nullptr){
+		this->cull(frustum);
+
 		//Update the uniforms
 		this->updateUniforms();
 
@@ -98,8 +204,10 @@ public:
 		this->overrideTextureSpecular->bind(1);
 
 		//Draw
-		for(auto& i : this->meshes){
-			i->render(shader, GL_TRIANGLES);
+		for(size_t i = 0; i < this->meshes.size(); i++){
+			if(this->visible[i]){
+				this->meshes[i]->render(shader, GL_TRIANGLES);
+			}
 		}
 	}
 
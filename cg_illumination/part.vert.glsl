@@ -1,20 +1,28 @@
-#version 410 core
+#version 430 core
 
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec4 color;
 layout(location = 2) in vec2 texCoord;
 layout(location = 3) in vec3 normal;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// one entry per living particle, streamed every frame by ParticleSystem2D
+struct ParticleInstance{
+	mat4 mvp;
+	vec4 color;
+};
+
+layout(std430, binding = 1) readonly buffer ParticleInstances{
+	ParticleInstance instances[];
+};
 
 out vec4 shaderColor;
 out vec2 shaderTexCoord;
 
 void main(){
-	shaderColor = color;
+	ParticleInstance instance = instances[gl_InstanceID];
+
+	shaderColor = color * instance.color;
 	shaderTexCoord = texCoord;
 	
-	gl_Position = projection * view * model * vec4(position, 1.f);
+	gl_Position = instance.mvp * vec4(position, 1.f);
 }
\ No newline at end of file
@@ -1,13 +1,25 @@
 #pragma once
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 
 struct Particle{
+	glm::vec3 position;
+	glm::vec3 rotation;
+	glm::vec3 scale;
 	glm::vec3 velocity;
 	glm::vec3 angularVelocity;
 	glm::vec4 color;
 	GLfloat life;
-	Mesh* mesh;
 
-	Particle(): velocity(0.f), angularVelocity(0.f), color(1.f), life(0.f), mesh(new Mesh(new Quad(color))){}
+	Particle(): position(0.f), rotation(0.f), scale(1.f), velocity(0.f), angularVelocity(0.f), color(1.f), life(0.f){}
+
+	// Same order as Mesh::updateModelMatrix, rotations in degrees
+	glm::mat4 getModelMatrix() const{
+		glm::mat4 model = glm::translate(glm::mat4(1.f), this->position);
+		model = glm::rotate(model, glm::radians(this->rotation.x), glm::vec3(1.f, 0.f, 0.f));
+		model = glm::rotate(model, glm::radians(this->rotation.y), glm::vec3(0.f, 1.f, 0.f));
+		model = glm::rotate(model, glm::radians(this->rotation.z), glm::vec3(0.f, 0.f, 1.f));
+		return glm::scale(model, this->scale);
+	}
 };
\ No newline at end of file
@@ -5,11 +5,23 @@
 #include "object.h"
 #include "material.h"
 #include "texture.h"
+#include "streamBuffer.h"
+#include "transformBatch.h"
 
 class ParticleSystem2D{
 private:
+	// Per instance data read by part.vert.glsl through gl_InstanceID
+	struct ParticleInstance{
+		glm::mat4 mvp;
+		glm::vec4 color;
+	};
+
 	GLuint nParticles;
 	std::vector<Particle> particles;
+	Mesh* quad;
+	std::vector<glm::mat4> models;
+	std::vector<glm::vec4> colors;
+	std::vector<DrawTransform> transforms;
 	GLuint lastUsedParticle = 0;
 	glm::vec3 position;
 	glm::vec3 velocity;
@@ -49,10 +61,9 @@ private:
 		GLfloat rAngularVelocityy = rand() % 10;
 		GLfloat rAngularVelocityz = rand() % 10;
 		GLfloat rColor = .5f + ((rand() % 100) / 100.f);
-		p.mesh->setPosition(this->position);
-		p.mesh->move(glm::vec3(rOffsetx, 0.f, rOffsetz));
-		p.mesh->setScale(glm::vec3(rScale));
-		p.mesh->setRotation(glm::vec3(rRotationx, rRotationy, rRotationz));
+		p.position = this->position + glm::vec3(rOffsetx, 0.f, rOffsetz);
+		p.scale = glm::vec3(rScale);
+		p.rotation = glm::vec3(rRotationx, rRotationy, rRotationz);
 		p.color = glm::vec4(rColor, rColor, rColor, 1.f);
 		p.life = 40.f;
 		p.velocity = this->velocity * .1f + glm::vec3(rVelocityx, -rVelocityy, rVelocityz);
@@ -68,6 +79,14 @@ public:
 		for(int i = 0; i < this->nParticles; i++){
 			this->particles.push_back(Particle());
 		}
+
+		// All particles share one quad and are drawn instanced
+		Quad quad(glm::vec4(1.f));
+		this->quad = new Mesh(&quad);
+	}
+
+	~ParticleSystem2D(){
+		delete this->quad;
 	}
 
 	void Update(float dt, int nNew = 0){
@@ -81,21 +100,43 @@ public:
 		for(Particle &p : this->particles){
 			p.life -= dt;
 			if(p.life > 0.f){
-				p.mesh->move(p.velocity * dt);
-				p.mesh->rotate(p.angularVelocity * dt);
+				p.position += p.velocity * dt;
+				p.rotation += p.angularVelocity * dt;
 				p.color.a -= dt * 2.5f;
 			}
 		}
 	}
 
-	void Render(Shader* shader){
-		//glBlendFunc(GL_SRC_ALPHA, GL_ONE);
-		for(Particle p : this->particles){
+	void Render(Shader* shader, StreamBuffer* stream){
+		// Collect living particles
+		this->models.clear();
+		this->colors.clear();
+		for(const Particle& p : this->particles){
 			if(p.life > 0.f){
-				this->texture->bind(0);
-				p.mesh->render(shader);
+				this->models.push_back(p.getModelMatrix());
+				this->colors.push_back(p.color);
 			}
 		}
+		if(this->models.empty()){
+			return;
+		}
+		computeDrawTransforms(shader->getViewProjection(), this->models, this->transforms);
+
+		// Write the instances straight into the mapped stream buffer
+		StreamAllocation allocation = stream->allocate(this->models.size() * sizeof(ParticleInstance), stream->getStorageAlignment());
+		if(!allocation.data){
+			return;
+		}
+		ParticleInstance* instances = (ParticleInstance*)allocation.data;
+		for(size_t i = 0; i < this->models.size(); i++){
+			instances[i].mvp = this->transforms[i].mvp;
+			instances[i].color = this->colors[i];
+		}
+		stream->bindRange(GL_SHADER_STORAGE_BUFFER, 1, allocation);
+
+		//glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+		this->texture->bind(0);
+		this->quad->renderInstanced(shader, (GLsizei)this->models.size());
 		//glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	}
 };
\ No newline at end of file
@@ -0,0 +1,246 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <cmath>
+
+#include <xmmintrin.h>
+
+#include <glm/glm.hpp>
+
+#include "vertex.h"
+#include "mesh.h"
+
+// Evaluates quartic Bézier patches on the CPU exactly like main.tes.glsl: 25 control points per patch, point
+// (i, j) at index i + 5 * j, i runs along u and j along v. Normals are du x dv from the analytic derivatives.
+// Serves as reference for the tessellation shaders and as fallback geometry where tessellation isn't available.
+// A patch is sampled on a (resolution + 1)^2 grid, four u samples at a time with SSE.
+class PatchEvaluator{
+private:
+	int resolution;
+	int rowSize;                                // Samples per row, rounded up to a multiple of 4
+	std::vector<float> basisU[5];               // Bernstein weights and their derivatives of every column
+	std::vector<float> derivativeU[5];
+
+	// Collapsed edges (poles) have du x dv = 0, the normal is taken from a point slightly inside the patch
+	static glm::vec3 safeNormal(const glm::vec3* controlPoints, float u, float v){
+		glm::vec3 position;
+		glm::vec3 normal;
+		for(int i = 0; i < 4; i++){
+			evaluate(controlPoints, u, v, position, normal);
+			if(normal != glm::vec3(0.f)){
+				return normal;
+			}
+			u += (0.5f - u) * 1e-3f;
+			v += (0.5f - v) * 1e-3f;
+		}
+		return normal;
+	}
+
+public:
+	PatchEvaluator(int resolution = 16){
+		this->resolution = std::max(1, resolution);
+		this->rowSize = (this->resolution + 1 + 3) & ~3;
+		for(int i = 0; i < 5; i++){
+			this->basisU[i].assign(this->rowSize, 0.f);
+			this->derivativeU[i].assign(this->rowSize, 0.f);
+		}
+		for(int x = 0; x <= this->resolution; x++){
+			float b[5];
+			float d[5];
+			basis((float)x / this->resolution, b, d);
+			for(int i = 0; i < 5; i++){
+				this->basisU[i][x] = b[i];
+				this->derivativeU[i][x] = d[i];
+			}
+		}
+	}
+
+	//Accessors
+	inline int getResolution() const{return this->resolution;}
+	inline int getNrOfSamples() const{return (this->resolution + 1) * (this->resolution + 1);}
+
+	//Functions
+
+	// Quartic Bernstein polynomials at t and their derivatives, B'i = 4 (B3(i-1) - B3(i)) with the cubic ones
+	static void basis(float t, float b[5], float d[5]){
+		float s = 1.f - t;
+		b[0] = s * s * s * s;
+		b[1] = 4.f * t * s * s * s;
+		b[2] = 6.f * t * t * s * s;
+		b[3] = 4.f * t * t * t * s;
+		b[4] = t * t * t * t;
+
+		float c0 = s * s * s;
+		float c1 = 3.f * t * s * s;
+		float c2 = 3.f * t * t * s;
+		float c3 = t * t * t;
+		d[0] = -4.f * c0;
+		d[1] = 4.f * (c0 - c1);
+		d[2] = 4.f * (c1 - c2);
+		d[3] = 4.f * (c2 - c3);
+		d[4] = 4.f * c3;
+	}
+
+	// Scalar reference for one point, the normal is 0 where the derivatives are parallel
+	static void evaluate(const glm::vec3* controlPoints, float u, float v, glm::vec3& position, glm::vec3& normal){
+		float bu[5], du[5], bv[5], dv[5];
+		basis(u, bu, du);
+		basis(v, bv, dv);
+
+		position = glm::vec3(0.f);
+		glm::vec3 tangentU(0.f);
+		glm::vec3 tangentV(0.f);
+		for(int j = 0; j < 5; j++){
+			for(int i = 0; i < 5; i++){
+				const glm::vec3& p = controlPoints[i + 5 * j];
+				position += bu[i] * bv[j] * p;
+				tangentU += du[i] * bv[j] * p;
+				tangentV += bu[i] * dv[j] * p;
+			}
+		}
+		glm::vec3 n = glm::cross(tangentU, tangentV);
+		float length = glm::length(n);
+		normal = length > 1e-12f ? n / length : glm::vec3(0.f);
+	}
+
+	// Sample one patch, positions and normals hold getNrOfSamples() entries in rows of constant v
+	void evaluate(const glm::vec3* controlPoints, glm::vec3* positions, glm::vec3* normals) const{
+		const int samples = this->resolution + 1;
+		for(int y = 0; y < samples; y++){
+			float v = (float)y / this->resolution;
+			float bv[5], dv[5];
+			basis(v, bv, dv);
+
+			// Collapse the v direction first: 5 curves in u for the position and for the v derivative
+			glm::vec3 curve[5];
+			glm::vec3 curveV[5];
+			for(int i = 0; i < 5; i++){
+				curve[i] = glm::vec3(0.f);
+				curveV[i] = glm::vec3(0.f);
+				for(int j = 0; j < 5; j++){
+					curve[i] += bv[j] * controlPoints[i + 5 * j];
+					curveV[i] += dv[j] * controlPoints[i + 5 * j];
+				}
+			}
+
+			for(int x = 0; x < samples; x += 4){
+				__m128 px = _mm_setzero_ps(), py = _mm_setzero_ps(), pz = _mm_setzero_ps();
+				__m128 ux = _mm_setzero_ps(), uy = _mm_setzero_ps(), uz = _mm_setzero_ps();
+				__m128 vx = _mm_setzero_ps(), vy = _mm_setzero_ps(), vz = _mm_setzero_ps();
+				for(int i = 0; i < 5; i++){
+					__m128 b = _mm_loadu_ps(&this->basisU[i][x]);
+					__m128 d = _mm_loadu_ps(&this->derivativeU[i][x]);
+					__m128 cx = _mm_set1_ps(curve[i].x), cy = _mm_set1_ps(curve[i].y), cz = _mm_set1_ps(curve[i].z);
+					px = _mm_add_ps(px, _mm_mul_ps(b, cx));
+					py = _mm_add_ps(py, _mm_mul_ps(b, cy));
+					pz = _mm_add_ps(pz, _mm_mul_ps(b, cz));
+					ux = _mm_add_ps(ux, _mm_mul_ps(d, cx));
+					uy = _mm_add_ps(uy, _mm_mul_ps(d, cy));
+					uz = _mm_add_ps(uz, _mm_mul_ps(d, cz));
+					vx = _mm_add_ps(vx, _mm_mul_ps(b, _mm_set1_ps(curveV[i].x)));
+					vy = _mm_add_ps(vy, _mm_mul_ps(b, _mm_set1_ps(curveV[i].y)));
+					vz = _mm_add_ps(vz, _mm_mul_ps(b, _mm_set1_ps(curveV[i].z)));
+				}
+
+				// n = du x dv, normalized where it isn't degenerate
+				__m128 nx = _mm_sub_ps(_mm_mul_ps(uy, vz), _mm_mul_ps(uz, vy));
+				__m128 ny = _mm_sub_ps(_mm_mul_ps(uz, vx), _mm_mul_ps(ux, vz));
+				__m128 nz = _mm_sub_ps(_mm_mul_ps(ux, vy), _mm_mul_ps(uy, vx));
+				__m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz));
+				__m128 valid = _mm_cmpgt_ps(lengthSquared, _mm_set1_ps(1e-24f));
+				__m128 inverse = _mm_and_ps(_mm_div_ps(_mm_set1_ps(1.f), _mm_sqrt_ps(lengthSquared)), valid);
+				nx = _mm_mul_ps(nx, inverse);
+				ny = _mm_mul_ps(ny, inverse);
+				nz = _mm_mul_ps(nz, inverse);
+
+				float out[6][4];
+				_mm_storeu_ps(out[0], px);
+				_mm_storeu_ps(out[1], py);
+				_mm_storeu_ps(out[2], pz);
+				_mm_storeu_ps(out[3], nx);
+				_mm_storeu_ps(out[4], ny);
+				_mm_storeu_ps(out[5], nz);
+				int validMask = _mm_movemask_ps(valid);
+				for(int k = 0; k < 4 && x + k < samples; k++){
+					size_t index = (size_t)y * samples + x + k;
+					positions[index] = glm::vec3(out[0][k], out[1][k], out[2][k]);
+					if(validMask & (1 << k)){
+						normals[index] = glm::vec3(out[3][k], out[4][k], out[5][k]);
+					}else{
+						normals[index] = safeNormal(controlPoints, (float)(x + k) / this->resolution, v);
+					}
+				}
+			}
+		}
+	}
+
+	// Sample every patch of a control point list (25 per patch), patches are spread over nrOfThreads, 0 uses all cores
+	void evaluate(const std::vector<glm::vec3>& controlPoints, std::vector<glm::vec3>& positions, std::vector<glm::vec3>& normals,
+		unsigned nrOfThreads = 0) const{
+		size_t nrOfPatches = controlPoints.size() / 25;
+		size_t samples = this->getNrOfSamples();
+		positions.resize(nrOfPatches * samples);
+		normals.resize(nrOfPatches * samples);
+
+		std::atomic<size_t> next(0);
+		auto worker = [&](){
+			for(size_t patch = next++; patch < nrOfPatches; patch = next++){
+				this->evaluate(&controlPoints[patch * 25], &positions[patch * samples], &normals[patch * samples]);
+			}
+		};
+
+		if(nrOfThreads == 0){
+			nrOfThreads = std::thread::hardware_concurrency();
+		}
+		nrOfThreads = (unsigned)std::max<size_t>(1, std::min<size_t>(nrOfThreads, nrOfPatches));
+		std::vector<std::thread> threads;
+		for(unsigned i = 1; i < nrOfThreads; i++){
+			threads.push_back(std::thread(worker));
+		}
+		worker();
+		for(auto& i : threads){
+			i.join();
+		}
+	}
+
+	// Triangulated patches as an indexed Mesh, texture coordinates are (u, v) like in main.tes.glsl.
+	// Triangles are counter clockwise in (u, v), so they face along du x dv.
+	Mesh* createMesh(const std::vector<glm::vec3>& controlPoints, glm::vec4 color = glm::vec4(1.f)) const{
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec3> normals;
+		this->evaluate(controlPoints, positions, normals);
+
+		const int samples = this->resolution + 1;
+		size_t nrOfPatches = controlPoints.size() / 25;
+		std::vector<Vertex> vertices(positions.size());
+		std::vector<GLuint> indices;
+		indices.reserve(nrOfPatches * this->resolution * this->resolution * 6);
+		for(size_t patch = 0; patch < nrOfPatches; patch++){
+			GLuint first = (GLuint)(patch * samples * samples);
+			for(int y = 0; y < samples; y++){
+				for(int x = 0; x < samples; x++){
+					GLuint index = first + y * samples + x;
+					Vertex vertex = {positions[index], color, glm::vec2((float)x / this->resolution, (float)y / this->resolution), normals[index]};
+					vertices[index] = vertex;
+				}
+			}
+			for(int y = 0; y < this->resolution; y++){
+				for(int x = 0; x < this->resolution; x++){
+					GLuint a = first + y * samples + x;
+					GLuint b = a + 1;
+					GLuint c = a + samples + 1;
+					GLuint d = a + samples;
+					indices.insert(indices.end(), {a, b, c, a, c, d});
+				}
+			}
+		}
+		if(vertices.empty()){
+			std::cout << "ERROR::PATCHEVALUATOR::NO_PATCHES" << "\n";
+		}
+		return new Mesh(vertices.data(), (unsigned)vertices.size(), indices.data(), (unsigned)indices.size());
+	}
+};
@@ -0,0 +1,683 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+#include <glm/glm.hpp>
+
+#include "meshSimplifier.h"
+#include "patchEvaluator.h"
+
+// Offline converter from a dense triangle mesh (the "v"/"f" files Mesh reads) to quartic Bézier patches in the
+// layout of main.tcs.glsl, written as "v" control points and "p" lines of 25 control point indices.
+// The mesh is simplified to a coarse base and every base triangle is split into three quads (corner, edge midpoints,
+// centroid), one patch each. A patch interpolates a 5x5 grid of points projected onto the dense surface along the
+// smoothed normals of the base mesh. Neighbouring patches share the samples of their common edge, so their boundary
+// curves match and the control points are welded into one list. Base triangles whose patches miss the tolerance
+// are bisected at their longest edge, with neighbours split as well so the base stays free of T-junctions, until
+// every patch is within the tolerance. Flat regions keep their large patches, so the output grows with the detail
+// of the surface rather than with its triangle count.
+class PatchFitter{
+private:
+	// Uniform grid over the triangles of the dense mesh for closest point queries
+	struct TriangleGrid{
+		const std::vector<glm::vec3>* positions;
+		const std::vector<GLuint>* indices;
+		glm::vec3 minimum;
+		float cellSize;
+		glm::ivec3 size;
+		std::vector<std::vector<GLuint>> cells;
+
+		glm::ivec3 cellOf(const glm::vec3& p) const{
+			glm::ivec3 cell;
+			for(int i = 0; i < 3; i++){
+				cell[i] = std::min(std::max((int)std::floor((p[i] - this->minimum[i]) / this->cellSize), 0), this->size[i] - 1);
+			}
+			return cell;
+		}
+
+		void build(const std::vector<glm::vec3>& positions, const std::vector<GLuint>& indices){
+			this->positions = &positions;
+			this->indices = &indices;
+			glm::vec3 maximum = positions[0];
+			this->minimum = positions[0];
+			float edges = 0.f;
+			for(size_t i = 0; i < indices.size(); i += 3){
+				edges += glm::distance(positions[indices[i]], positions[indices[i + 1]]);
+			}
+			for(auto& i : positions){
+				this->minimum = glm::min(this->minimum, i);
+				maximum = glm::max(maximum, i);
+			}
+			this->cellSize = std::max(2.f * edges / std::max<size_t>(1, indices.size() / 3), 1e-6f);
+			for(int i = 0; i < 3; i++){
+				this->size[i] = std::max(1, std::min(256, (int)std::ceil((maximum[i] - this->minimum[i]) / this->cellSize) + 1));
+			}
+			this->cells.assign((size_t)this->size.x * this->size.y * this->size.z, std::vector<GLuint>());
+			for(GLuint t = 0; t < indices.size() / 3; t++){
+				glm::vec3 a = positions[indices[t * 3]];
+				glm::vec3 b = positions[indices[t * 3 + 1]];
+				glm::vec3 c = positions[indices[t * 3 + 2]];
+				glm::ivec3 low = this->cellOf(glm::min(a, glm::min(b, c)));
+				glm::ivec3 high = this->cellOf(glm::max(a, glm::max(b, c)));
+				for(int z = low.z; z <= high.z; z++){
+					for(int y = low.y; y <= high.y; y++){
+						for(int x = low.x; x <= high.x; x++){
+							this->cells[((size_t)z * this->size.y + y) * this->size.x + x].push_back(t);
+						}
+					}
+				}
+			}
+		}
+
+		// Closest point on triangle abc to p (Ericson, Real-Time Collision Detection 5.1.5)
+		static glm::vec3 closestOnTriangle(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c){
+			glm::vec3 ab = b - a;
+			glm::vec3 ac = c - a;
+			glm::vec3 ap = p - a;
+			float d1 = glm::dot(ab, ap);
+			float d2 = glm::dot(ac, ap);
+			if(d1 <= 0.f && d2 <= 0.f){
+				return a;
+			}
+			glm::vec3 bp = p - b;
+			float d3 = glm::dot(ab, bp);
+			float d4 = glm::dot(ac, bp);
+			if(d3 >= 0.f && d4 <= d3){
+				return b;
+			}
+			float vc = d1 * d4 - d3 * d2;
+			if(vc <= 0.f && d1 >= 0.f && d3 <= 0.f){
+				return a + ab * (d1 / (d1 - d3));
+			}
+			glm::vec3 cp = p - c;
+			float d5 = glm::dot(ab, cp);
+			float d6 = glm::dot(ac, cp);
+			if(d6 >= 0.f && d5 <= d6){
+				return c;
+			}
+			float vb = d5 * d2 - d1 * d6;
+			if(vb <= 0.f && d2 >= 0.f && d6 <= 0.f){
+				return a + ac * (d2 / (d2 - d6));
+			}
+			float va = d3 * d6 - d5 * d4;
+			if(va <= 0.f && (d4 - d3) >= 0.f && (d5 - d6) >= 0.f){
+				return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+			}
+			float denominator = 1.f / (va + vb + vc);
+			return a + ab * (vb * denominator) + ac * (vc * denominator);
+		}
+
+		// Ray triangle intersection (Möller and Trumbore), t along direction, false if it misses
+		static bool intersect(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& a, const glm::vec3& b,
+			const glm::vec3& c, float& t){
+			glm::vec3 ab = b - a;
+			glm::vec3 ac = c - a;
+			glm::vec3 p = glm::cross(direction, ac);
+			float det = glm::dot(ab, p);
+			if(std::abs(det) < 1e-20f){
+				return false;
+			}
+			float inv = 1.f / det;
+			glm::vec3 s = origin - a;
+			float u = glm::dot(s, p) * inv;
+			if(u < -1e-5f || u > 1.f + 1e-5f){
+				return false;
+			}
+			glm::vec3 q = glm::cross(s, ab);
+			float v = glm::dot(direction, q) * inv;
+			if(v < -1e-5f || u + v > 1.f + 1e-5f){
+				return false;
+			}
+			t = glm::dot(ac, q) * inv;
+			return true;
+		}
+
+		// Hit of the line p + t n, |t| <= maxDistance, closest to p. Walks the cells along the line (Amanatides and Woo).
+		bool cast(const glm::vec3& p, const glm::vec3& n, float maxDistance, glm::vec3& hit) const{
+			glm::vec3 start = p - n * maxDistance;
+			glm::vec3 direction = n * (2.f * maxDistance);
+			glm::ivec3 cell = this->cellOf(start);
+			glm::ivec3 last = this->cellOf(start + direction);
+			glm::ivec3 step;
+			glm::vec3 next;
+			glm::vec3 delta;
+			for(int i = 0; i < 3; i++){
+				step[i] = direction[i] > 0.f ? 1 : -1;
+				float boundary = this->minimum[i] + (cell[i] + (direction[i] > 0.f ? 1 : 0)) * this->cellSize;
+				float length = std::abs(direction[i]);
+				next[i] = length > 0.f ? (boundary - start[i]) / direction[i] : std::numeric_limits<float>::max();
+				delta[i] = length > 0.f ? this->cellSize / length : std::numeric_limits<float>::max();
+			}
+			const std::vector<glm::vec3>& v = *this->positions;
+			const std::vector<GLuint>& i = *this->indices;
+			float best = std::numeric_limits<float>::max();
+			int limit = this->size.x + this->size.y + this->size.z;
+			while(limit-- > 0){
+				for(GLuint t : this->cells[((size_t)cell.z * this->size.y + cell.y) * this->size.x + cell.x]){
+					float distance;
+					if(intersect(p, n, v[i[t * 3]], v[i[t * 3 + 1]], v[i[t * 3 + 2]], distance) &&
+						std::abs(distance) <= maxDistance && std::abs(distance) < std::abs(best)){
+						best = distance;
+					}
+				}
+				if(cell == last){
+					break;
+				}
+				int axis = next.x < next.y ? (next.x < next.z ? 0 : 2) : (next.y < next.z ? 1 : 2);
+				if(next[axis] > 1.f){
+					break;
+				}
+				cell[axis] += step[axis];
+				next[axis] += delta[axis];
+				if(cell[axis] < 0 || cell[axis] >= this->size[axis]){
+					break;
+				}
+			}
+			if(best == std::numeric_limits<float>::max()){
+				return false;
+			}
+			hit = p + n * best;
+			return true;
+		}
+
+		// Searches shells of cells around p until no closer triangle can exist
+		glm::vec3 closest(const glm::vec3& p) const{
+			glm::ivec3 center = this->cellOf(p);
+			glm::vec3 best = p;
+			float bestDistance = std::numeric_limits<float>::max();
+			int maxRadius = std::max(this->size.x, std::max(this->size.y, this->size.z));
+			for(int r = 0; r <= maxRadius; r++){
+				for(int z = center.z - r; z <= center.z + r; z++){
+					for(int y = center.y - r; y <= center.y + r; y++){
+						for(int x = center.x - r; x <= center.x + r; x++){
+							bool shell = std::abs(x - center.x) == r || std::abs(y - center.y) == r || std::abs(z - center.z) == r;
+							if(!shell || x < 0 || y < 0 || z < 0 || x >= this->size.x || y >= this->size.y || z >= this->size.z){
+								continue;
+							}
+							for(GLuint t : this->cells[((size_t)z * this->size.y + y) * this->size.x + x]){
+								const std::vector<glm::vec3>& v = *this->positions;
+								const std::vector<GLuint>& i = *this->indices;
+								glm::vec3 q = closestOnTriangle(p, v[i[t * 3]], v[i[t * 3 + 1]], v[i[t * 3 + 2]]);
+								float distance = glm::distance(p, q);
+								if(distance < bestDistance){
+									bestDistance = distance;
+									best = q;
+								}
+							}
+						}
+					}
+				}
+				// Everything outside the searched cells is at least r cells away
+				if(bestDistance <= r * this->cellSize){
+					break;
+				}
+			}
+			return best;
+		}
+	};
+
+	// Corners of a base quad in (u, v) order 00, 10, 11, 01, counter clockwise like the base triangle, with the
+	// smoothed normals of the base mesh along which the samples are projected
+	struct Quad{
+		glm::vec3 corners[4];
+		glm::vec3 normals[4];
+	};
+
+	// Inverse of the 5x5 matrix of the quartic Bernstein polynomials at t = 0, 1/4, ..., 1
+	static void inverseBasis(double inverse[5][5]){
+		double m[5][10];
+		for(int a = 0; a < 5; a++){
+			float b[5];
+			float d[5];
+			PatchEvaluator::basis(a / 4.f, b, d);
+			for(int i = 0; i < 5; i++){
+				m[a][i] = b[i];
+				m[a][i + 5] = a == i ? 1.0 : 0.0;
+			}
+		}
+		// Gauss-Jordan with partial pivoting
+		for(int c = 0; c < 5; c++){
+			int pivot = c;
+			for(int r = c + 1; r < 5; r++){
+				if(std::abs(m[r][c]) > std::abs(m[pivot][c])){
+					pivot = r;
+				}
+			}
+			for(int i = 0; i < 10; i++){
+				std::swap(m[c][i], m[pivot][i]);
+			}
+			double scale = 1.0 / m[c][c];
+			for(int i = 0; i < 10; i++){
+				m[c][i] *= scale;
+			}
+			for(int r = 0; r < 5; r++){
+				if(r != c){
+					double factor = m[r][c];
+					for(int i = 0; i < 10; i++){
+						m[r][i] -= factor * m[c][i];
+					}
+				}
+			}
+		}
+		for(int r = 0; r < 5; r++){
+			for(int i = 0; i < 5; i++){
+				inverse[r][i] = m[r][i + 5];
+			}
+		}
+	}
+
+	static glm::vec3 bilinear(const glm::vec3 corners[4], float u, float v){
+		return (1.f - u) * (1.f - v) * corners[0] + u * (1.f - v) * corners[1] + u * v * corners[2] + (1.f - u) * v * corners[3];
+	}
+
+	// Area weighted, not normalized
+	static void vertexNormals(const std::vector<glm::vec3>& positions, const std::vector<GLuint>& indices, std::vector<glm::vec3>& normals){
+		normals.assign(positions.size(), glm::vec3(0.f));
+		for(size_t t = 0; t < indices.size(); t += 3){
+			glm::vec3 normal = glm::cross(positions[indices[t + 1]] - positions[indices[t]], positions[indices[t + 2]] - positions[indices[t]]);
+			for(int i = 0; i < 3; i++){
+				normals[indices[t + i]] += normal;
+			}
+		}
+	}
+
+	// Three quads per base triangle, edge midpoints are computed from the sorted endpoints so that both triangles of
+	// an edge get the bit-identical point
+	static void splitTriangles(const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& normals,
+		const std::vector<GLuint>& indices, std::vector<Quad>& quads){
+		auto midpoint = [&positions](GLuint a, GLuint b){
+			return (positions[std::min(a, b)] + positions[std::max(a, b)]) * 0.5f;
+		};
+		auto midnormal = [&normals](GLuint a, GLuint b){
+			return glm::normalize(glm::normalize(normals[std::min(a, b)]) + glm::normalize(normals[std::max(a, b)]));
+		};
+		for(size_t t = 0; t < indices.size(); t += 3){
+			GLuint v[3] = {indices[t], indices[t + 1], indices[t + 2]};
+			glm::vec3 centroid = (positions[v[0]] + positions[v[1]] + positions[v[2]]) / 3.f;
+			glm::vec3 centroidNormal = glm::normalize(glm::normalize(normals[v[0]]) + glm::normalize(normals[v[1]]) + glm::normalize(normals[v[2]]));
+			for(int i = 0; i < 3; i++){
+				Quad quad;
+				quad.corners[0] = positions[v[i]];
+				quad.corners[1] = midpoint(v[i], v[(i + 1) % 3]);
+				quad.corners[2] = centroid;
+				quad.corners[3] = midpoint(v[(i + 2) % 3], v[i]);
+				quad.normals[0] = glm::normalize(normals[v[i]]);
+				quad.normals[1] = midnormal(v[i], v[(i + 1) % 3]);
+				quad.normals[2] = centroidNormal;
+				quad.normals[3] = midnormal(v[(i + 2) % 3], v[i]);
+				quads.push_back(quad);
+			}
+		}
+	}
+
+	// Sample point (i, j) of the samples x samples grid of a quad and its projection direction. Boundary samples are
+	// interpolated from the edge's endpoints in a fixed order, so the quad on the other side computes the same values.
+	static void gridPoint(const Quad& quad, int i, int j, int samples, glm::vec3& point, glm::vec3& normal){
+		float last = (float)(samples - 1);
+		int edgeCorners[4][2] = {{0, 1}, {1, 2}, {3, 2}, {0, 3}};
+		int edge = j == 0 ? 0 : i == samples - 1 ? 1 : j == samples - 1 ? 2 : i == 0 ? 3 : -1;
+		if(edge < 0){
+			point = bilinear(quad.corners, i / last, j / last);
+			normal = glm::normalize(bilinear(quad.normals, i / last, j / last));
+			return;
+		}
+		int k = edge == 0 || edge == 2 ? i : j;
+		int a = edgeCorners[edge][0];
+		int b = edgeCorners[edge][1];
+		const glm::vec3& pa = quad.corners[a];
+		const glm::vec3& pb = quad.corners[b];
+		if(pb.x < pa.x || (pb.x == pa.x && (pb.y < pa.y || (pb.y == pa.y && pb.z < pa.z)))){
+			std::swap(a, b);
+			k = samples - 1 - k;
+		}
+		float t = k / last;
+		point = k == samples - 1 ? quad.corners[b] : quad.corners[a] * (1.f - t) + quad.corners[b] * t;
+		normal = glm::normalize(quad.normals[a] * (1.f - t) + quad.normals[b] * t);
+	}
+
+	static unsigned long long edgeKey(GLuint a, GLuint b){
+		return ((unsigned long long)std::min(a, b) << 32) | std::max(a, b);
+	}
+
+	// Longest of the edges of triangle abc that pass the filter, -1 if none does. Ties go to the larger edge key, so
+	// both triangles of an edge agree.
+	template<typename Filter>
+	static int longestEdge(const std::vector<glm::vec3>& positions, const GLuint* triangle, Filter filter){
+		int best = -1;
+		float bestLength = -1.f;
+		unsigned long long bestKey = 0;
+		for(int i = 0; i < 3; i++){
+			GLuint a = triangle[i];
+			GLuint b = triangle[(i + 1) % 3];
+			unsigned long long key = edgeKey(a, b);
+			if(!filter(key)){
+				continue;
+			}
+			float length = glm::distance(positions[std::min(a, b)], positions[std::max(a, b)]);
+			if(length > bestLength || (length == bestLength && key > bestKey)){
+				best = i;
+				bestLength = length;
+				bestKey = key;
+			}
+		}
+		return best;
+	}
+
+	// Longest edge bisection of the marked triangles. Every triangle with a split edge splits its longest edge too,
+	// the other split edges then cut its halves, so every edge ends up split on both sides or on neither.
+	// New vertices stay at the edge midpoints with the interpolated normals: the refined base is a subdivision of the
+	// coarse one and keeps projecting onto the surface the same way, unrefined patches don't change.
+	static void bisect(std::vector<glm::vec3>& positions, std::vector<glm::vec3>& normals, std::vector<GLuint>& indices,
+		const std::vector<bool>& marked){
+		const GLuint NONE = 0xFFFFFFFF;
+		size_t nrOfTriangles = indices.size() / 3;
+		auto any = [](unsigned long long){return true;};
+		std::unordered_map<unsigned long long, GLuint> midpoints;
+		for(size_t t = 0; t < nrOfTriangles; t++){
+			if(marked[t]){
+				int edge = longestEdge(positions, &indices[t * 3], any);
+				midpoints[edgeKey(indices[t * 3 + edge], indices[t * 3 + (edge + 1) % 3])] = NONE;
+			}
+		}
+		for(bool changed = true; changed;){
+			changed = false;
+			for(size_t t = 0; t < nrOfTriangles; t++){
+				const GLuint* triangle = &indices[t * 3];
+				int edge = longestEdge(positions, triangle, any);
+				unsigned long long longest = edgeKey(triangle[edge], triangle[(edge + 1) % 3]);
+				if(midpoints.count(longest)){
+					continue;
+				}
+				for(int i = 0; i < 3; i++){
+					if(midpoints.count(edgeKey(triangle[i], triangle[(i + 1) % 3]))){
+						midpoints[longest] = NONE;
+						changed = true;
+						break;
+					}
+				}
+			}
+		}
+
+		for(auto& i : midpoints){
+			GLuint a = (GLuint)(i.first >> 32);
+			GLuint b = (GLuint)(i.first & 0xFFFFFFFF);
+			glm::vec3 normal = glm::normalize(normals[a]) + glm::normalize(normals[b]);
+			i.second = (GLuint)positions.size();
+			positions.push_back((positions[a] + positions[b]) * 0.5f);
+			normals.push_back(normal);
+		}
+
+		// Halves keep the winding, (a, b, c) split at m on ab gives (a, m, c) and (m, b, c)
+		std::vector<GLuint> result;
+		result.reserve(indices.size() * 2);
+		std::vector<GLuint> stack;
+		auto isSplit = [&midpoints](unsigned long long key){return midpoints.count(key) > 0;};
+		for(size_t t = 0; t < nrOfTriangles; t++){
+			stack.assign(indices.begin() + t * 3, indices.begin() + t * 3 + 3);
+			while(!stack.empty()){
+				GLuint triangle[3] = {stack[stack.size() - 3], stack[stack.size() - 2], stack[stack.size() - 1]};
+				stack.resize(stack.size() - 3);
+				int edge = longestEdge(positions, triangle, isSplit);
+				if(edge < 0){
+					result.insert(result.end(), triangle, triangle + 3);
+					continue;
+				}
+				GLuint a = triangle[edge];
+				GLuint b = triangle[(edge + 1) % 3];
+				GLuint c = triangle[(edge + 2) % 3];
+				GLuint m = midpoints[edgeKey(a, b)];
+				GLuint halves[6] = {a, m, c, m, b, c};
+				stack.insert(stack.end(), halves, halves + 6);
+			}
+		}
+		indices.swap(result);
+	}
+
+	// One patch per quad and its largest distance to the dense surface, on all cores
+	static void fitQuads(const std::vector<Quad>& quads, const TriangleGrid& grid, float rayLength, const double inverse[5][5],
+		const PatchEvaluator& evaluator, std::vector<glm::vec3>& controlPoints, std::vector<float>& errors){
+		controlPoints.assign(quads.size() * 25, glm::vec3(0.f));
+		errors.assign(quads.size(), 0.f);
+		unsigned nrOfThreads = std::max(1u, std::thread::hardware_concurrency());
+
+		std::atomic<size_t> next(0);
+		auto worker = [&](){
+			glm::vec3 surface[25];
+			std::vector<glm::vec3> evaluated(evaluator.getNrOfSamples());
+			std::vector<glm::vec3> normals(evaluator.getNrOfSamples());
+			for(size_t q = next++; q < quads.size(); q = next++){
+				for(int j = 0; j < 5; j++){
+					for(int i = 0; i < 5; i++){
+						// Projecting along the interpolated normals is continuous, closest points jump across concave regions
+						glm::vec3 point;
+						glm::vec3 normal;
+						gridPoint(quads[q], i, j, 5, point, normal);
+						if(!grid.cast(point, normal, rayLength, surface[j * 5 + i])){
+							surface[j * 5 + i] = grid.closest(point);
+						}
+					}
+				}
+
+				// C = B^-1 S B^-T, first along u then along v
+				glm::vec3 rows[5][5];
+				for(int j = 0; j < 5; j++){
+					for(int i = 0; i < 5; i++){
+						glm::vec3 sum(0.f);
+						for(int k = 0; k < 5; k++){
+							sum += (float)inverse[i][k] * surface[j * 5 + k];
+						}
+						rows[j][i] = sum;
+					}
+				}
+				glm::vec3* patch = &controlPoints[q * 25];
+				for(int j = 0; j < 5; j++){
+					for(int i = 0; i < 5; i++){
+						glm::vec3 sum(0.f);
+						for(int k = 0; k < 5; k++){
+							sum += (float)inverse[j][k] * rows[k][i];
+						}
+						patch[i + 5 * j] = sum;
+					}
+				}
+
+				// Distance of the patch to the dense surface between the samples
+				evaluator.evaluate(patch, evaluated.data(), normals.data());
+				for(auto& i : evaluated){
+					errors[q] = std::max(errors[q], glm::distance(i, grid.closest(i)));
+				}
+			}
+		};
+		std::vector<std::thread> threads;
+		for(unsigned i = 1; i < nrOfThreads; i++){
+			threads.push_back(std::thread(worker));
+		}
+		worker();
+		for(auto& i : threads){
+			i.join();
+		}
+	}
+
+	static bool loadTriangles(const char* path, std::vector<glm::vec3>& positions, std::vector<GLuint>& indices){
+		std::ifstream in_file(path);
+		if(!in_file){
+			return false;
+		}
+		std::string line;
+		while(std::getline(in_file, line)){
+			std::stringstream stream(line);
+			std::string header;
+			stream >> header;
+			if(header == "v"){
+				glm::vec3 position;
+				stream >> position.x >> position.y >> position.z;
+				positions.push_back(position);
+			}else if(header == "f"){
+				GLuint face[3];
+				stream >> face[0] >> face[1] >> face[2];
+				for(int i = 0; i < 3; i++){
+					indices.push_back(face[i] - 1);
+				}
+			}
+		}
+		return !indices.empty();
+	}
+
+	// Key of a welded control point, points closer than the cell size end up in the same or a neighbouring cell
+	static long long weldKey(const glm::ivec3& cell){
+		return ((long long)(cell.x & 0x1FFFFF) << 42) | ((long long)(cell.y & 0x1FFFFF) << 21) | (long long)(cell.z & 0x1FFFFF);
+	}
+
+public:
+	// Fit patches to the triangle mesh in inputPath and write them to outputPath. tolerance is the largest allowed
+	// distance of the patches to the dense surface relative to its bounding radius, baseTriangles the size of the
+	// coarse base mesh before refinement (0 for the default) and maxPasses the number of refinement passes.
+	// Returns false if the file couldn't be read or written.
+	static bool fit(const char* inputPath, const char* outputPath, float tolerance = 0.005f, size_t baseTriangles = 0, int maxPasses = 12){
+		typedef std::chrono::steady_clock Clock;
+		Clock::time_point start = Clock::now();
+
+		std::vector<glm::vec3> positions;
+		std::vector<GLuint> indices;
+		if(!loadTriangles(inputPath, positions, indices)){
+			std::cout << "ERROR::PATCHFITTER::COULD_NOT_READ_MESH: " << inputPath << "\n";
+			return false;
+		}
+		TriangleGrid grid;
+		grid.build(positions, indices);
+
+		glm::vec3 minimum = positions[0];
+		glm::vec3 maximum = positions[0];
+		for(auto& i : positions){
+			minimum = glm::min(minimum, i);
+			maximum = glm::max(maximum, i);
+		}
+		float radius = glm::length(maximum - minimum) * 0.5f;
+		float maxError = tolerance * radius;
+
+		std::vector<glm::vec3> basePositions = positions;
+		std::vector<GLuint> baseIndices = indices;
+		// The default only depends on the shape: fewer base triangles let the projection along the base normals fold
+		// over narrow features, refinement adds patches where the surface needs them
+		if(baseTriangles == 0){
+			baseTriangles = 128;
+		}
+		MeshSimplifier::simplify(basePositions, baseIndices, baseTriangles);
+
+		// Rays reach a bit further than the longest base edge, the base surface doesn't deviate more than that
+		float rayLength = 0.f;
+		for(size_t i = 0; i < baseIndices.size(); i += 3){
+			for(int j = 0; j < 3; j++){
+				rayLength = std::max(rayLength, glm::distance(basePositions[baseIndices[i + j]], basePositions[baseIndices[i + (j + 1) % 3]]));
+			}
+		}
+
+		double inverse[5][5];
+		inverseBasis(inverse);
+		PatchEvaluator evaluator(8);
+
+		std::vector<glm::vec3> baseNormals;
+		vertexNormals(basePositions, baseIndices, baseNormals);
+		std::vector<Quad> quads;
+		std::vector<glm::vec3> controlPoints;
+		std::vector<float> errors;
+		float error = 0.f;
+		for(int pass = 0;; pass++){
+			quads.clear();
+			splitTriangles(basePositions, baseNormals, baseIndices, quads);
+			fitQuads(quads, grid, rayLength, inverse, evaluator, controlPoints, errors);
+
+			// The three quads of base triangle t are quads 3t to 3t + 2
+			std::vector<bool> marked(baseIndices.size() / 3, false);
+			size_t nrOfMarked = 0;
+			error = 0.f;
+			for(size_t q = 0; q < quads.size(); q++){
+				error = std::max(error, errors[q]);
+				if(errors[q] > maxError && !marked[q / 3]){
+					marked[q / 3] = true;
+					nrOfMarked++;
+				}
+			}
+			std::cout << "PATCHFITTER::PASS: " << quads.size() << " patches, error " << error / radius << ", "
+				<< nrOfMarked * 3 << " over the tolerance" << "\n";
+			if(nrOfMarked == 0){
+				break;
+			}
+			if(pass == maxPasses){
+				std::cout << "ERROR::PATCHFITTER::TOLERANCE_NOT_REACHED: " << error / radius << " after " << maxPasses << " passes" << "\n";
+				break;
+			}
+			bisect(basePositions, baseNormals, baseIndices, marked);
+		}
+
+		// Weld equal control points, shared boundary curves only differ by rounding
+		float weldDistance = radius * 1e-5f;
+		std::unordered_map<long long, std::vector<GLuint>> cells;
+		std::vector<glm::vec3> welded;
+		std::vector<GLuint> patchIndices(controlPoints.size());
+		for(size_t i = 0; i < controlPoints.size(); i++){
+			glm::ivec3 cell((int)std::floor(controlPoints[i].x / weldDistance), (int)std::floor(controlPoints[i].y / weldDistance),
+				(int)std::floor(controlPoints[i].z / weldDistance));
+			GLuint found = 0xFFFFFFFF;
+			for(int n = 0; n < 27 && found == 0xFFFFFFFF; n++){
+				auto it = cells.find(weldKey(cell + glm::ivec3(n % 3 - 1, n / 3 % 3 - 1, n / 9 - 1)));
+				if(it == cells.end()){
+					continue;
+				}
+				for(GLuint j : it->second){
+					if(glm::distance(welded[j], controlPoints[i]) <= weldDistance){
+						found = j;
+						break;
+					}
+				}
+			}
+			if(found == 0xFFFFFFFF){
+				found = (GLuint)welded.size();
+				welded.push_back(controlPoints[i]);
+				cells[weldKey(cell)].push_back(found);
+			}
+			patchIndices[i] = found;
+		}
+
+		std::ofstream out_file(outputPath);
+		if(!out_file){
+			std::cout << "ERROR::PATCHFITTER::COULD_NOT_WRITE: " << outputPath << "\n";
+			return false;
+		}
+		size_t nrOfPatches = patchIndices.size() / 25;
+		out_file << "# quartic Bezier patches fitted to " << inputPath << "\n";
+		out_file << "# control points: " << welded.size() << "\n";
+		out_file << "# patches: " << nrOfPatches << "\n";
+		for(auto& i : welded){
+			out_file << "v " << i.x << " " << i.y << " " << i.z << "\n";
+		}
+		for(size_t i = 0; i < nrOfPatches; i++){
+			out_file << "p";
+			for(int j = 0; j < 25; j++){
+				out_file << " " << patchIndices[i * 25 + j] + 1;
+			}
+			out_file << "\n";
+		}
+
+		// Positions and indices only, attributes are the same per vertex on both sides
+		size_t inputSize = positions.size() * sizeof(glm::vec3) + indices.size() * sizeof(GLuint);
+		size_t outputSize = welded.size() * sizeof(glm::vec3) + patchIndices.size() * sizeof(GLuint);
+		double time = std::chrono::duration<double>(Clock::now() - start).count();
+		std::cout << "PATCHFITTER::FITTED: " << inputPath << " " << indices.size() / 3 << " triangles, " << positions.size()
+			<< " vertices (" << inputSize << " bytes) -> " << nrOfPatches << " patches, " << welded.size() << " control points ("
+			<< outputSize << " bytes), error " << error / radius << " of the radius in " << time << "s" << "\n";
+		return true;
+	}
+};
@@ -5,131 +5,474 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <iomanip>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
 
 #include <glad/glad.h>
 
+#include "hash.h"
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// Macros a program variant is compiled with, name to value
+typedef std::map<std::string, std::string> ShaderDefines;
+
+// One stage of a program, the source is kept so it can be hashed
+struct ShaderStage{
+	GLenum type;
+	std::string path;
+	std::string source;
+	std::vector<std::string> files;    // Every file the source was assembled from, index = GLSL source string number
+};
+
 class Shader{
 private:
+	static const unsigned BINARY_CACHE_VERSION = 1;
+
 	GLuint program;
+	glm::mat4 viewProjection;
 	const int versionMajor;
 	const int versionMinor;
+	std::vector<ShaderStage> stages;
+
+	// Compile and link run in the driver until the status is first queried
+	bool pending;
+	std::vector<GLuint> pendingShaders;
+	std::chrono::steady_clock::time_point buildStart;
+	double issueTime;           // Milliseconds spent issuing compile and link
+	double completedTime;       // Milliseconds from buildStart until the driver was first seen done, -1 until then
+	std::string cachePath;
 
-	// Retrieves shader source code from file
-	std::string loadShaderSource(const GLchar* fileName){
+	// Hot reload builds a replacement next to the current program, it is swapped in once it linked
+	ShaderDefines defines;
+	bool reloading;
+	GLuint reloadProgram;
+	std::vector<GLuint> reloadShaders;
+	std::vector<ShaderStage> reloadStages;
+
+	// Retrieves shader source code from file and expands #include "file" relative to the including file.
+	// Every file is included once, #line directives keep compiler messages pointing at the right file and line.
+	std::string readSource(const std::string& fileName, std::vector<std::string>& files, int depth = 0){
 		std::string temp = "";
 		std::string src = "";
 		std::ifstream in_file;
 		// Ensure ifstream object can throw exceptions:
 		in_file.exceptions(std::ifstream::badbit);
 
-		// Vertex
+		int fileIndex = (int)files.size();
+		files.push_back(fileName);
+		std::string directory = fileName.substr(0, fileName.find_last_of("/\\") + 1);
+
 		try{
 			in_file.open(fileName);
+			if(!in_file.is_open()){
+				std::cout << "ERROR::SHADER::COULD_NOT_OPEN_FILE: " << fileName << "\n";
+			}
+			int line = 0;
 			while(std::getline(in_file, temp)){
-				src += temp + "\n";
+				line++;
+				size_t start = temp.find_first_not_of(" \t");
+				if(start == std::string::npos || temp.compare(start, 8, "#include") != 0){
+					src += temp + "\n";
+					continue;
+				}
+
+				size_t open = temp.find('"', start);
+				size_t close = open == std::string::npos ? std::string::npos : temp.find('"', open + 1);
+				if(close == std::string::npos || depth >= 16){
+					std::cout << "ERROR::SHADER::INVALID_INCLUDE: " << fileName << "(" << line << ")" << "\n";
+					src += "\n";
+					continue;
+				}
+				std::string include = directory + temp.substr(open + 1, close - open - 1);
+				if(std::find(files.begin(), files.end(), include) != files.end()){
+					src += "\n";
+					continue;
+				}
+				src += "#line 1 " + std::to_string(files.size()) + "\n";
+				src += this->readSource(include, files, depth + 1);
+				src += "#line " + std::to_string(line + 1) + " " + std::to_string(fileIndex) + "\n";
 			}
 			in_file.close();
 		}catch (std::ifstream::failure e){
 			std::cout << "ERROR::SHADER::COULD_NOT_OPEN_FILE: " << fileName << "\n";
 		}
+		return src;
+	}
+
+	// Preprocessed source of a stage: includes expanded, version number patched and defines added
+	std::string loadShaderSource(const GLchar* fileName, const ShaderDefines& defines, std::vector<std::string>& files){
+		std::string src = this->readSource(fileName, files);
 
 		// Update version number if used in shader
 		std::string versionNr =
 			std::to_string(this->versionMajor) +
 			std::to_string(this->versionMinor) +
 			"0";
-		src.replace(src.find("#version"), 12, ("#version " + versionNr));
+		size_t version = src.find("#version");
+		if(version != std::string::npos){
+			src.replace(version, 12, ("#version " + versionNr));
+
+			// Defines go right after the version line, followed by a #line so line numbers stay unchanged
+			size_t end = src.find('\n', version);
+			if(end != std::string::npos && !defines.empty()){
+				int versionLine = (int)std::count(src.begin(), src.begin() + version, '\n') + 1;
+				std::string block;
+				for(auto& i : defines){
+					block += "#define " + i.first + " " + i.second + "\n";
+				}
+				block += "#line " + std::to_string(versionLine + 1) + " 0\n";
+				src.insert(end + 1, block);
+			}
+		}
 		return src;
 	}
 
-	// Compile shaders
-	GLuint loadShader(GLenum type, const GLchar* fileName){
-		char infoLog[512];
-		GLint success;
-
-		GLuint shader = glCreateShader(type);
-		std::string str_src = this->loadShaderSource(fileName);
-		const GLchar* src = str_src.c_str();
+	// Compile shaders, the status is checked later so the driver can work in parallel
+	GLuint loadShader(const ShaderStage& stage){
+		GLuint shader = glCreateShader(stage.type);
+		const GLchar* src = stage.source.c_str();
 		glShaderSource(shader, 1, &src, NULL);
 		glCompileShader(shader);
+		return shader;
+	}
+
+	bool checkShader(GLuint shader, const ShaderStage& stage){
+		char infoLog[512];
+		GLint success;
 
 		glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
 		if(!success){
 			glGetShaderInfoLog(shader, 512, NULL, infoLog);
-			std::cout << "ERROR::SHADER::COULD_NOT_COMPILE_SHADER: " << fileName << "\n";
+			std::cout << "ERROR::SHADER::COULD_NOT_COMPILE_SHADER: " << stage.path << "\n";
+			// Messages refer to files by source string number
+			for(size_t i = 1; i < stage.files.size(); i++){
+				std::cout << i << ": " << stage.files[i] << "\n";
+			}
 			std::cout << infoLog << "\n";
 		}
-		return shader;
+		return success == GL_TRUE;
 	}
 
 	// Link Shaders
-	void linkProgram(GLuint vertexShader, GLuint geometryShader, GLuint tessctrlShader, GLuint tessevalShader, GLuint fragmentShader){
+	GLuint linkProgram(const std::vector<GLuint>& shaders){
+		GLuint program = glCreateProgram();
+		// Ask the driver to keep the binary around for the cache
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+		for(auto& i : shaders){
+			glAttachShader(program, i);
+		}
+
+		glLinkProgram(program);
+		return program;
+	}
+
+	bool checkProgram(GLuint program){
 		char infoLog[512];
 		GLint success;
 
-		this->program = glCreateProgram();
-
-		glAttachShader(this->program, vertexShader);
-		if(geometryShader){
-			glAttachShader(this->program, geometryShader);
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if(!success){
+			glGetProgramInfoLog(program, 512, NULL, infoLog);
+			std::cout << "ERROR::SHADER::COULD_NOT_LINK_PROGRAM" << "\n";
+			std::cout << infoLog << "\n";
 		}
-		if(tessctrlShader){
-			glAttachShader(this->program, tessctrlShader);
+		return success == GL_TRUE;
+	}
+
+	// Hash of the driver identification and every preprocessed stage, a driver update invalidates the cache
+	unsigned long long hashSources(){
+		unsigned long long hash = Hash::OFFSET;
+		auto add = [&hash](const void* data, size_t size){
+			hash = Hash::bytes(data, size, hash);
+		};
+		GLenum strings[3] = {GL_VENDOR, GL_RENDERER, GL_VERSION};
+		for(GLenum i : strings){
+			const GLubyte* string = glGetString(i);
+			if(string){
+				add(string, std::strlen((const char*)string));
+			}
 		}
-		if(tessevalShader){
-			glAttachShader(this->program, tessevalShader);
+		for(auto& i : this->stages){
+			add(&i.type, sizeof(i.type));
+			add(i.source.data(), i.source.size());
 		}
-		glAttachShader(this->program, fragmentShader);
+		return hash;
+	}
 
-		glLinkProgram(this->program);
+	std::string binaryCachePath(){
+		std::stringstream path;
+		path << "shader_" << std::hex << std::setw(16) << std::setfill('0') << this->hashSources() << ".bin";
+		return path.str();
+	}
 
+	// Returns false if there is no cached binary or the driver rejects it
+	bool loadBinary(const std::string& path, double& compileTime){
+		std::ifstream in_file(path, std::ios::binary);
+		if(!in_file){
+			return false;
+		}
+		unsigned version = 0;
+		GLenum format = 0;
+		GLint length = 0;
+		in_file.read((char*)&version, sizeof(version));
+		in_file.read((char*)&compileTime, sizeof(compileTime));
+		in_file.read((char*)&format, sizeof(format));
+		in_file.read((char*)&length, sizeof(length));
+		if(!in_file || version != BINARY_CACHE_VERSION || length <= 0){
+			return false;
+		}
+		std::vector<char> binary(length);
+		in_file.read(binary.data(), length);
+		if(!in_file){
+			return false;
+		}
+
+		this->program = glCreateProgram();
+		glProgramBinary(this->program, format, binary.data(), length);
+		GLint success;
 		glGetProgramiv(this->program, GL_LINK_STATUS, &success);
 		if(!success){
-			glGetProgramInfoLog(this->program, 512, NULL, infoLog);
-			std::cout << "ERROR::SHADER::COULD_NOT_LINK_PROGRAM" << "\n";
-			std::cout << infoLog << "\n";
+			glDeleteProgram(this->program);
+			this->program = 0;
+			return false;
 		}
-		this->Use();
+		return true;
 	}
 
-public:
-	// Constructor generates the shader on the fly
-	Shader(const int versionMajor, const int versionMinor, const GLchar* vertexPath, const GLchar* fragmentPath,
-		const GLchar* geometryPath = "", const GLchar* tessctrlPath = "", const GLchar* tessevalPath = "") : versionMajor(versionMajor), versionMinor(versionMinor){
-		GLuint vertexShader = 0;
-		GLuint geometryShader = 0;
-		GLuint tessctrlShader = 0;
-		GLuint tessevalShader = 0;
-		GLuint fragmentShader = 0;
+	void saveBinary(const std::string& path, double compileTime){
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		GLint length = 0;
+		glGetProgramiv(this->program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if(formats == 0 || length <= 0){
+			return;
+		}
+		std::vector<char> binary(length);
+		GLenum format = 0;
+		glGetProgramBinary(this->program, length, NULL, &format, binary.data());
+
+		std::ofstream out_file(path, std::ios::binary);
+		if(!out_file){
+			std::cout << "ERROR::SHADER::COULD_NOT_WRITE_BINARY_CACHE: " << path << "\n";
+			return;
+		}
+		unsigned version = BINARY_CACHE_VERSION;
+		out_file.write((const char*)&version, sizeof(version));
+		out_file.write((const char*)&compileTime, sizeof(compileTime));
+		out_file.write((const char*)&format, sizeof(format));
+		out_file.write((const char*)&length, sizeof(length));
+		out_file.write(binary.data(), length);
+	}
+
+	static double millisecondsSince(std::chrono::steady_clock::time_point start){
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// Needs KHR_parallel_shader_compile
+	static bool isCompleted(GLuint program){
+		GLint completed = GL_FALSE;
+		glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &completed);
+		return completed == GL_TRUE;
+	}
 
-		vertexShader = loadShader(GL_VERTEX_SHADER, vertexPath);
-		if(geometryPath != ""){
-			geometryShader = loadShader(GL_GEOMETRY_SHADER, geometryPath);
+	// Remember when the driver first reports the program done, so polling once per frame times the build
+	bool pollCompletion(GLuint program){
+		if(this->completedTime < 0.0 && isCompleted(program)){
+			this->completedTime = millisecondsSince(this->buildStart);
 		}
-		if(tessctrlPath != ""){
-			tessctrlShader = loadShader(GL_TESS_CONTROL_SHADER, tessctrlPath);
+		return this->completedTime >= 0.0;
+	}
+
+	// Time the driver needed for the build whose status queries started at queryStart. Without parallel compile it
+	// works while compile and link are issued and while the status is queried. With it, the build is done when first
+	// seen done, a build still running at the query finishes during it. Time the program waited for its first use
+	// after it was done doesn't count, so a build nobody polled may come out shorter than it was, never longer.
+	double buildTime(std::chrono::steady_clock::time_point queryStart, bool runningAtQuery){
+		if(this->completedTime >= 0.0){
+			return this->completedTime;
 		}
-		if(tessevalPath != ""){
-			tessevalShader = loadShader(GL_TESS_EVALUATION_SHADER, tessevalPath);
+		if(runningAtQuery){
+			return millisecondsSince(this->buildStart);
 		}
-		fragmentShader = loadShader(GL_FRAGMENT_SHADER, fragmentPath);
+		return this->issueTime + millisecondsSince(queryStart);
+	}
 
-		this->linkProgram(vertexShader, geometryShader, tessctrlShader, tessevalShader, fragmentShader);
+	// Load the linked program from the binary cache, otherwise issue compile and link from source
+	void startBuild(){
+		typedef std::chrono::steady_clock Clock;
+		this->buildStart = Clock::now();
+		this->cachePath = this->binaryCachePath();
+
+		double compileTime = 0.0;
+		if(this->loadBinary(this->cachePath, compileTime)){
+			double loadTime = std::chrono::duration<double, std::milli>(Clock::now() - this->buildStart).count();
+			std::cout << "SHADER::LOADED_BINARY: " << this->stages[0].path << " in " << loadTime << "ms, saved "
+				<< compileTime - loadTime << "ms" << "\n";
+			this->pending = false;
+			return;
+		}
+
+		this->buildStart = Clock::now();
+		this->pendingShaders.clear();
+		for(auto& i : this->stages){
+			this->pendingShaders.push_back(this->loadShader(i));
+		}
+		this->program = this->linkProgram(this->pendingShaders);
+		this->pending = true;
+		this->issueTime = millisecondsSince(this->buildStart);
+		this->completedTime = -1.0;
+	}
+
+	// Query the results, blocks until the driver is done
+	void finishBuild(){
+		if(!this->pending){
+			return;
+		}
+		this->pending = false;
+
+		std::chrono::steady_clock::time_point queryStart = std::chrono::steady_clock::now();
+		bool running = this->completedTime < 0.0 && hasParallelCompile() && !isCompleted(this->program);
+		for(size_t i = 0; i < this->pendingShaders.size(); i++){
+			this->checkShader(this->pendingShaders[i], this->stages[i]);
+		}
+		bool linked = this->checkProgram(this->program);
 
 		// Delete the shaders as they're linked into our program now and no longer necessary
-		glDeleteShader(vertexShader);
-		glDeleteShader(geometryShader);
-		glDeleteShader(tessctrlShader);
-		glDeleteShader(tessevalShader);
-		glDeleteShader(fragmentShader);
+		for(auto& i : this->pendingShaders){
+			glDeleteShader(i);
+		}
+		this->pendingShaders.clear();
+
+		if(linked){
+			this->saveBinary(this->cachePath, this->buildTime(queryStart, running));
+		}
+	}
+
+	// Carry the values of the default block uniforms over to a reloaded program, matched by name.
+	// Uniforms that were removed or changed type keep the defaults of the new program.
+	static void copyUniforms(GLuint from, GLuint to){
+		GLint nrOfUniforms = 0;
+		glGetProgramiv(from, GL_ACTIVE_UNIFORMS, &nrOfUniforms);
+		for(GLint i = 0; i < nrOfUniforms; i++){
+			GLchar name[256];
+			GLint size = 0;
+			GLenum type = 0;
+			glGetActiveUniform(from, i, sizeof(name), NULL, &size, &type, name);
+
+			// Type and size come from the resource name, "name[0]" for arrays, elements past 0 have only a location
+			GLint targetSize = 0;
+			GLenum targetType = 0;
+			GLuint targetIndex = 0;
+			const GLchar* targetName = name;
+			glGetUniformIndices(to, 1, &targetName, &targetIndex);
+			if(targetIndex == GL_INVALID_INDEX){
+				continue;
+			}
+			glGetActiveUniform(to, targetIndex, 0, NULL, &targetSize, &targetType, NULL);
+			if(targetType != type){
+				continue;
+			}
+
+			std::string base = name;
+			if(base.size() > 3 && base.compare(base.size() - 3, 3, "[0]") == 0){
+				base.resize(base.size() - 3);
+			}
+			for(GLint element = 0; element < std::min(size, targetSize); element++){
+				std::string elementName = element > 0 ? base + "[" + std::to_string(element) + "]" : std::string(name);
+				GLint source = glGetUniformLocation(from, elementName.c_str());
+				GLint target = glGetUniformLocation(to, elementName.c_str());
+				if(source < 0 || target < 0){
+					continue;
+				}
+
+				GLfloat floats[16];
+				GLint ints[4];
+				GLuint uints[4];
+				switch(type){
+					case GL_FLOAT: glGetUniformfv(from, source, floats); glProgramUniform1fv(to, target, 1, floats); break;
+					case GL_FLOAT_VEC2: glGetUniformfv(from, source, floats); glProgramUniform2fv(to, target, 1, floats); break;
+					case GL_FLOAT_VEC3: glGetUniformfv(from, source, floats); glProgramUniform3fv(to, target, 1, floats); break;
+					case GL_FLOAT_VEC4: glGetUniformfv(from, source, floats); glProgramUniform4fv(to, target, 1, floats); break;
+					case GL_FLOAT_MAT2: glGetUniformfv(from, source, floats); glProgramUniformMatrix2fv(to, target, 1, GL_FALSE, floats); break;
+					case GL_FLOAT_MAT3: glGetUniformfv(from, source, floats); glProgramUniformMatrix3fv(to, target, 1, GL_FALSE, floats); break;
+					case GL_FLOAT_MAT4: glGetUniformfv(from, source, floats); glProgramUniformMatrix4fv(to, target, 1, GL_FALSE, floats); break;
+					case GL_INT_VEC2: case GL_BOOL_VEC2: glGetUniformiv(from, source, ints); glProgramUniform2iv(to, target, 1, ints); break;
+					case GL_INT_VEC3: case GL_BOOL_VEC3: glGetUniformiv(from, source, ints); glProgramUniform3iv(to, target, 1, ints); break;
+					case GL_INT_VEC4: case GL_BOOL_VEC4: glGetUniformiv(from, source, ints); glProgramUniform4iv(to, target, 1, ints); break;
+					case GL_UNSIGNED_INT: glGetUniformuiv(from, source, uints); glProgramUniform1uiv(to, target, 1, uints); break;
+					case GL_UNSIGNED_INT_VEC2: glGetUniformuiv(from, source, uints); glProgramUniform2uiv(to, target, 1, uints); break;
+					case GL_UNSIGNED_INT_VEC3: glGetUniformuiv(from, source, uints); glProgramUniform3uiv(to, target, 1, uints); break;
+					case GL_UNSIGNED_INT_VEC4: glGetUniformuiv(from, source, uints); glProgramUniform4uiv(to, target, 1, uints); break;
+					// int, bool and the sampler and image types are all set as one int
+					default: glGetUniformiv(from, source, ints); glProgramUniform1iv(to, target, 1, ints); break;
+				}
+			}
+		}
+	}
+
+	void discardReload(){
+		for(auto& i : this->reloadShaders){
+			glDeleteShader(i);
+		}
+		this->reloadShaders.clear();
+		glDeleteProgram(this->reloadProgram);
+		this->reloadProgram = 0;
+		this->reloading = false;
+	}
+
+public:
+	// Constructor generates the shader on the fly
+	Shader(const int versionMajor, const int versionMinor, const GLchar* vertexPath, const GLchar* fragmentPath,
+		const GLchar* geometryPath = "", const GLchar* tessctrlPath = "", const GLchar* tessevalPath = "",
+		bool deferred = false, const ShaderDefines& defines = ShaderDefines()) : viewProjection(1.f), versionMajor(versionMajor), versionMinor(versionMinor){
+		this->program = 0;
+		this->pending = false;
+		this->issueTime = 0.0;
+		this->completedTime = -1.0;
+		this->defines = defines;
+		this->reloading = false;
+		this->reloadProgram = 0;
+
+		// Stages in pipeline order, the order is part of the cache key
+		const GLchar* paths[5] = {vertexPath, tessctrlPath, tessevalPath, geometryPath, fragmentPath};
+		GLenum types[5] = {GL_VERTEX_SHADER, GL_TESS_CONTROL_SHADER, GL_TESS_EVALUATION_SHADER, GL_GEOMETRY_SHADER, GL_FRAGMENT_SHADER};
+		for(int i = 0; i < 5; i++){
+			if(paths[i] && paths[i][0] != '\0'){
+				ShaderStage stage;
+				stage.type = types[i];
+				stage.path = paths[i];
+				stage.source = this->loadShaderSource(paths[i], defines, stage.files);
+				this->stages.push_back(stage);
+			}
+		}
+
+		// Deferred shaders only query their status when first used, see ShaderLibrary
+		this->startBuild();
+		if(!deferred){
+			this->finishBuild();
+			this->Use();
+		}
 	}
 
 	~Shader(){
+		this->discardReload();
+		for(auto& i : this->pendingShaders){
+			glDeleteShader(i);
+		}
 		glDeleteProgram(this->program);
 	}
 
 	// Uses the current shader
 	void Use(){
+		this->finishBuild();
 		glUseProgram(this->program);
 	}
 
@@ -139,9 +482,124 @@ public:
 
 	// Accessors
 	GLuint getProgram(){
+		this->finishBuild();
 		return this->program;
 	}
 
+	inline bool isPending() const{return this->pending;}
+	inline bool isReloading() const{return this->reloading;}
+
+	// Every file the stages were assembled from, includes too
+	std::vector<std::string> getFiles() const{
+		std::vector<std::string> files;
+		for(auto& i : this->stages){
+			for(auto& j : i.files){
+				if(std::find(files.begin(), files.end(), j) == files.end()){
+					files.push_back(j);
+				}
+			}
+		}
+		return files;
+	}
+
+	// True if using the program won't block, needs KHR_parallel_shader_compile to know before the driver is done
+	bool isReady(){
+		if(!this->pending){
+			return true;
+		}
+		return !hasParallelCompile() || this->pollCompletion(this->program);
+	}
+
+	// Read the stage files again and start building a replacement program, the current program stays in use
+	// until updateReload() swaps it. A reload that is still building is dropped for the newer one.
+	void reload(){
+		this->finishBuild();
+		if(this->reloading){
+			this->discardReload();
+		}
+
+		this->reloadStages.clear();
+		for(auto& i : this->stages){
+			ShaderStage stage;
+			stage.type = i.type;
+			stage.path = i.path;
+			stage.source = this->loadShaderSource(i.path.c_str(), this->defines, stage.files);
+			this->reloadStages.push_back(stage);
+		}
+		this->buildStart = std::chrono::steady_clock::now();
+		for(auto& i : this->reloadStages){
+			this->reloadShaders.push_back(this->loadShader(i));
+		}
+		this->reloadProgram = this->linkProgram(this->reloadShaders);
+		this->reloading = true;
+		this->issueTime = millisecondsSince(this->buildStart);
+		this->completedTime = -1.0;
+	}
+
+	// Swap in a finished reload, call once per frame. With parallel compile this only checks the status once the
+	// driver is done, otherwise the first call waits for it. A failed build is deleted and the old program kept.
+	// Returns true if the program changed.
+	bool updateReload(){
+		if(!this->reloading){
+			return false;
+		}
+		if(hasParallelCompile() && !this->pollCompletion(this->reloadProgram)){
+			return false;
+		}
+
+		std::chrono::steady_clock::time_point queryStart = std::chrono::steady_clock::now();
+		bool compiled = true;
+		for(size_t i = 0; i < this->reloadShaders.size(); i++){
+			compiled = this->checkShader(this->reloadShaders[i], this->reloadStages[i]) && compiled;
+		}
+		if(!compiled || !this->checkProgram(this->reloadProgram)){
+			std::cout << "ERROR::SHADER::RELOAD_FAILED: " << this->stages[0].path << ", keeping the previous program" << "\n";
+			this->discardReload();
+			return false;
+		}
+
+		double compileTime = this->buildTime(queryStart, false);
+		copyUniforms(this->program, this->reloadProgram);
+		glDeleteProgram(this->program);
+		this->program = this->reloadProgram;
+		this->reloadProgram = 0;
+		std::swap(this->stages, this->reloadStages);
+		this->discardReload();
+
+		this->cachePath = this->binaryCachePath();
+		this->saveBinary(this->cachePath, compileTime);
+		std::cout << "SHADER::RELOADED: " << this->stages[0].path << " in " << compileTime << "ms" << "\n";
+		return true;
+	}
+
+	// KHR/ARB_parallel_shader_compile, checked once (the loader was generated without extensions)
+	static bool hasParallelCompile(){
+		static int supported = -1;
+		if(supported < 0){
+			supported = 0;
+			GLint nrOfExtensions = 0;
+			glGetIntegerv(GL_NUM_EXTENSIONS, &nrOfExtensions);
+			for(GLint i = 0; i < nrOfExtensions; i++){
+				const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+				if(name && (!std::strcmp(name, "GL_KHR_parallel_shader_compile") || !std::strcmp(name, "GL_ARB_parallel_shader_compile"))){
+					supported = 1;
+				}
+			}
+		}
+		return supported == 1;
+	}
+
+	// Camera matrices of the frame, meshes combine them with their model matrix on the CPU
+	void setViewProjection(const glm::mat4& view, const glm::mat4& projection){
+		this->viewProjection = projection * view;
+		this->setMat4fv(view, "view");
+		this->setMat4fv(projection, "projection");
+	}
+
+	const glm::mat4& getViewProjection(){
+		return this->viewProjection;
+	}
+
 	// Set uniforms
 	void set1i(GLint value, const GLchar* name){
 		this->Use();
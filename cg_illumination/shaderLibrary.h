@@ -0,0 +1,205 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <map>
+#include <vector>
+#include <algorithm>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "shader.h"
+#include "fileWatcher.h"
+
+// Owns every shader program of the application by name.
+// add() only issues compile and link, the status of a program is queried when it is first used, so the driver
+// compiles all programs at once instead of one after the other. With KHR_parallel_shader_compile the driver
+// also spreads the work over its own threads and isReady() tells whether using a program would still block.
+// Permutations of a program are requested by their defines and compiled the first time they are asked for.
+// After watch(), update() rebuilds every program whose files (includes too) changed on disk and swaps the new
+// build in on a later frame once the driver finished it, a program that fails to build keeps running the previous
+// version.
+class ShaderLibrary{
+private:
+	typedef void (APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count);
+
+	// Stage files of a named program, variants are built from them on demand
+	struct ProgramFiles{
+		std::string vertex;
+		std::string fragment;
+		std::string geometry;
+		std::string tessctrl;
+		std::string tesseval;
+	};
+
+	std::map<std::string, Shader*> shaders;
+	std::map<std::string, ProgramFiles> programs;
+	const int versionMajor;
+	const int versionMinor;
+	FileWatcher* watcher;
+
+	// Name of a variant, defines are sorted by the map so equal sets give equal keys
+	static std::string variantKey(const std::string& name, const ShaderDefines& defines){
+		std::string key = name;
+		for(auto& i : defines){
+			key += "|" + i.first + "=" + i.second;
+		}
+		return key;
+	}
+
+	Shader* create(const ProgramFiles& files, const ShaderDefines& defines){
+		Shader* shader = new Shader(this->versionMajor, this->versionMinor, files.vertex.c_str(), files.fragment.c_str(),
+			files.geometry.c_str(), files.tessctrl.c_str(), files.tesseval.c_str(), true, defines);
+		this->watchFiles(shader);
+		return shader;
+	}
+
+	void watchFiles(Shader* shader){
+		if(!this->watcher){
+			return;
+		}
+		for(auto& i : shader->getFiles()){
+			this->watcher->add(i);
+		}
+	}
+
+public:
+	ShaderLibrary(const int versionMajor, const int versionMinor) : versionMajor(versionMajor), versionMinor(versionMinor){
+		this->watcher = nullptr;
+		if(Shader::hasParallelCompile()){
+			// Let the driver pick the number of compiler threads
+			MaxShaderCompilerThreadsProc maxShaderCompilerThreads = (MaxShaderCompilerThreadsProc)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+			if(!maxShaderCompilerThreads){
+				maxShaderCompilerThreads = (MaxShaderCompilerThreadsProc)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+			}
+			if(maxShaderCompilerThreads){
+				maxShaderCompilerThreads(0xFFFFFFFF);
+			}
+		}
+	}
+
+	~ShaderLibrary(){
+		for(auto& i : this->shaders){
+			delete i.second;
+		}
+		delete this->watcher;
+	}
+
+	//Accessors
+	inline size_t getNrOfShaders() const{return this->shaders.size();}
+
+	size_t getNrOfPending(){
+		size_t pending = 0;
+		for(auto& i : this->shaders){
+			pending += i.second->isReady() ? 0 : 1;
+		}
+		return pending;
+	}
+
+	//Functions
+
+	// Starts building the program without defines, replaces an existing program with the same name and its variants
+	Shader* add(const std::string& name, const GLchar* vertexPath, const GLchar* fragmentPath,
+		const GLchar* geometryPath = "", const GLchar* tessctrlPath = "", const GLchar* tessevalPath = ""){
+		for(auto it = this->shaders.begin(); it != this->shaders.end();){
+			if(it->first == name || it->first.compare(0, name.size() + 1, name + "|") == 0){
+				delete it->second;
+				it = this->shaders.erase(it);
+			}else{
+				it++;
+			}
+		}
+		ProgramFiles files = {vertexPath, fragmentPath, geometryPath, tessctrlPath, tessevalPath};
+		this->programs[name] = files;
+
+		Shader* shader = this->create(files, ShaderDefines());
+		this->shaders[name] = shader;
+		return shader;
+	}
+
+	// The program is finished on first use, not here
+	Shader* get(const std::string& name){
+		auto it = this->shaders.find(name);
+		if(it == this->shaders.end()){
+			std::cout << "ERROR::SHADERLIBRARY::UNKNOWN_SHADER: " << name << "\n";
+			return nullptr;
+		}
+		return it->second;
+	}
+
+	// Variant of an added program compiled with the defines, built on the first request and kept afterwards
+	Shader* get(const std::string& name, const ShaderDefines& defines){
+		if(defines.empty()){
+			return this->get(name);
+		}
+		std::string key = variantKey(name, defines);
+		auto it = this->shaders.find(key);
+		if(it != this->shaders.end()){
+			return it->second;
+		}
+		auto program = this->programs.find(name);
+		if(program == this->programs.end()){
+			std::cout << "ERROR::SHADERLIBRARY::UNKNOWN_SHADER: " << name << "\n";
+			return nullptr;
+		}
+		Shader* shader = this->create(program->second, defines);
+		this->shaders[key] = shader;
+		return shader;
+	}
+
+	bool isReady(const std::string& name){
+		Shader* shader = this->get(name);
+		return shader && shader->isReady();
+	}
+
+	// Start watching the files of all programs, including ones added later
+	void watch(double pollInterval = 0.5){
+		if(this->watcher){
+			return;
+		}
+		this->watcher = new FileWatcher(pollInterval);
+		for(auto& i : this->shaders){
+			this->watchFiles(i.second);
+		}
+	}
+
+	// Call once per frame before rendering: swaps in rebuilds started on earlier frames that are done, then starts
+	// rebuilds of changed programs. A rebuild is collected on a later frame at the earliest, so the driver compiles
+	// it while the frames in between render. Without KHR_parallel_shader_compile the driver can't say when it is
+	// done, the next frame collects it and waits there for whatever compiling is left.
+	// Returns the number of programs that changed this frame.
+	size_t update(){
+		if(!this->watcher){
+			return 0;
+		}
+
+		size_t swapped = 0;
+		for(auto& i : this->shaders){
+			if(i.second->updateReload()){
+				// A new #include may have come with the change
+				this->watchFiles(i.second);
+				swapped++;
+			}
+		}
+
+		std::vector<std::string> changed = this->watcher->poll();
+		for(auto& i : this->shaders){
+			std::vector<std::string> files = i.second->getFiles();
+			for(auto& j : changed){
+				if(std::find(files.begin(), files.end(), j) != files.end()){
+					i.second->reload();
+					break;
+				}
+			}
+		}
+		return swapped;
+	}
+
+	// Query the status of every program, for loading screens
+	void finishAll(){
+		for(auto& i : this->shaders){
+			i.second->getProgram();
+		}
+	}
+};
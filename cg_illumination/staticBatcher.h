@@ -0,0 +1,132 @@
+#pragma once
+
+#include <vector>
+#include <map>
+#include <tuple>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+#include "vertex.h"
+#include "mesh.h"
+#include "object.h"
+#include "material.h"
+#include "texture.h"
+
+// Merges static objects that share a material and textures into a few big meshes at scene build time.
+// Vertices are pre-transformed into world space, so the merged meshes render with an identity model matrix.
+// Batches never cross a cell of a uniform grid and never exceed maxVertices, so every batch stays
+// spatially compact and can still be culled as a whole.
+class StaticBatcher{
+private:
+	struct Entry{
+		Material* material;
+		Texture* diffuse;
+		Texture* specular;
+		Mesh* mesh;
+		glm::mat4 model;
+		glm::ivec3 cell;
+	};
+
+	std::vector<Entry> entries;
+	GLuint maxVertices;
+	GLfloat cellSize;
+
+	// Sort key, entries with the same state and cell end up next to each other
+	static bool compareEntries(const Entry& a, const Entry& b){
+		return std::make_tuple(a.material, a.diffuse, a.specular, a.cell.x, a.cell.y, a.cell.z)
+			< std::make_tuple(b.material, b.diffuse, b.specular, b.cell.x, b.cell.y, b.cell.z);
+	}
+
+	static bool sameBatch(const Entry& a, const Entry& b){
+		return a.material == b.material && a.diffuse == b.diffuse && a.specular == b.specular && a.cell == b.cell;
+	}
+
+	// Centroid of the transformed vertices decides which grid cell a mesh belongs to
+	glm::ivec3 findCell(Mesh* mesh, const glm::mat4& model){
+		glm::vec3 center(0.f);
+		for(unsigned i = 0; i < mesh->getNrOfVertices(); i++){
+			center += glm::vec3(model * glm::vec4(mesh->getVertices()[i].position, 1.f));
+		}
+		if(mesh->getNrOfVertices() > 0){
+			center /= (GLfloat)mesh->getNrOfVertices();
+		}
+		return glm::ivec3(glm::floor(center / this->cellSize));
+	}
+
+	// Append one mesh in world space to the batch arrays
+	void appendMesh(const Entry& entry, std::vector<Vertex>& vertices, std::vector<GLuint>& indices){
+		GLuint base = (GLuint)vertices.size();
+		glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(entry.model)));
+
+		for(unsigned i = 0; i < entry.mesh->getNrOfVertices(); i++){
+			Vertex vertex = entry.mesh->getVertices()[i];
+			vertex.position = glm::vec3(entry.model * glm::vec4(vertex.position, 1.f));
+			vertex.normal = glm::normalize(normalMatrix * vertex.normal);
+			vertices.push_back(vertex);
+		}
+
+		if(entry.mesh->getNrOfIndices() > 0){
+			for(unsigned i = 0; i < entry.mesh->getNrOfIndices(); i++){
+				indices.push_back(base + entry.mesh->getIndices()[i]);
+			}
+		}else{
+			for(unsigned i = 0; i < entry.mesh->getNrOfVertices(); i++){
+				indices.push_back(base + i);
+			}
+		}
+	}
+
+public:
+	StaticBatcher(GLuint maxVertices = 65536, GLfloat cellSize = 50.f){
+		this->maxVertices = maxVertices;
+		this->cellSize = cellSize;
+	}
+
+	~StaticBatcher(){}
+
+	//Functions
+
+	// Register every mesh of an object with its current transform, the object itself is not changed
+	void add(Object* object){
+		for(auto* i : object->getMeshes()){
+			this->add(i, object->getMaterial(), object->getTextureDiffuse(), object->getTextureSpecular());
+		}
+	}
+
+	void add(Mesh* mesh, Material* material, Texture* diffuse, Texture* specular){
+		glm::mat4 model = mesh->getModelMatrix();
+		Entry entry = {material, diffuse, specular, mesh, model, this->findCell(mesh, model)};
+		this->entries.push_back(entry);
+	}
+
+	// Build one object per batch, the caller owns the returned objects
+	std::vector<Object*> build(){
+		std::vector<Object*> objects;
+		std::sort(this->entries.begin(), this->entries.end(), compareEntries);
+
+		std::vector<Vertex> vertices;
+		std::vector<GLuint> indices;
+		for(size_t i = 0; i < this->entries.size(); i++){
+			const Entry& entry = this->entries[i];
+			vertices.clear();
+			indices.clear();
+			this->appendMesh(entry, vertices, indices);
+
+			// Keep adding meshes of the same state and cell while they fit
+			while(i + 1 < this->entries.size() && sameBatch(entry, this->entries[i + 1])
+				&& vertices.size() + this->entries[i + 1].mesh->getNrOfVertices() <= this->maxVertices){
+				i++;
+				this->appendMesh(this->entries[i], vertices, indices);
+			}
+
+			std::vector<Mesh*> meshes;
+			meshes.push_back(new Mesh(vertices.data(), (unsigned)vertices.size(), indices.data(), (unsigned)indices.size()));
+			objects.push_back(new Object(glm::vec3(0.f), entry.material, entry.diffuse, entry.specular, meshes));
+			delete meshes[0];
+		}
+
+		this->entries.clear();
+		return objects;
+	}
+};
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+
+#include <glad/glad.h>
+
+// Suballocated piece of a StreamBuffer, valid until the end of the current frame
+struct StreamAllocation{
+	GLintptr offset;
+	GLsizeiptr size;
+	void* data;
+};
+
+// Ring buffer for everything that is uploaded every frame.
+// The storage is created with glBufferStorage and stays persistently and coherently mapped, it is split into
+// nrOfRegions frame regions and each region is guarded by a fence, so writing into it never makes the
+// driver synchronize implicitly. A region is only reused once the GPU has passed the fence of its last frame.
+// A frame that doesn't fit makes the next beginFrame() wait for the GPU and grow all regions, the buffer is
+// replaced then, so users bind getBuffer() again every frame.
+class StreamBuffer{
+private:
+	GLuint buffer;
+	unsigned char* mapped;
+	GLsizeiptr regionSize;
+	unsigned nrOfRegions;
+
+	unsigned region;
+	GLsizeiptr head;
+	GLsizeiptr missing;         // Bytes of this frame's allocations that didn't fit
+	GLsync* fences;
+
+	GLint storageAlignment;
+	GLint uniformAlignment;
+
+	void waitForFence(GLsync& fence){
+		if(!fence){
+			return;
+		}
+		GLenum result = glClientWaitSync(fence, 0, 0);
+		while(result == GL_TIMEOUT_EXPIRED){
+			// Flush so the fence is guaranteed to signal, then wait 1ms at a time
+			result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		}
+		if(result == GL_WAIT_FAILED){
+			std::cout << "ERROR::STREAMBUFFER::WAIT_FAILED" << "\n";
+		}
+		glDeleteSync(fence);
+		fence = 0;
+	}
+
+	void createStorage(){
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glGenBuffers(1, &this->buffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, this->buffer);
+		glBufferStorage(GL_COPY_WRITE_BUFFER, this->regionSize * this->nrOfRegions, NULL, flags);
+		this->mapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, this->regionSize * this->nrOfRegions, flags);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+		if(!this->mapped){
+			std::cout << "ERROR::STREAMBUFFER::COULD_NOT_MAP_BUFFER" << "\n";
+		}
+	}
+
+	void deleteStorage(){
+		glBindBuffer(GL_COPY_WRITE_BUFFER, this->buffer);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		glDeleteBuffers(1, &this->buffer);
+	}
+
+	// Double the regions until a frame of needed bytes fits, once the GPU is done with all of them
+	void grow(GLsizeiptr needed){
+		for(unsigned i = 0; i < this->nrOfRegions; i++){
+			this->waitForFence(this->fences[i]);
+		}
+		GLsizeiptr regionSize = this->regionSize;
+		while(regionSize < needed){
+			regionSize *= 2;
+		}
+		std::cout << "STREAMBUFFER::GROWN: " << this->regionSize << " -> " << regionSize << " bytes per region" << "\n";
+		this->deleteStorage();
+		this->regionSize = regionSize;
+		this->createStorage();
+	}
+
+public:
+	StreamBuffer(GLsizeiptr regionSize = 4 << 20, unsigned nrOfRegions = 3){
+		this->regionSize = regionSize;
+		this->nrOfRegions = nrOfRegions;
+		this->region = 0;
+		this->head = 0;
+		this->missing = 0;
+
+		this->fences = new GLsync[nrOfRegions];
+		for(unsigned i = 0; i < nrOfRegions; i++){
+			this->fences[i] = 0;
+		}
+
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &this->storageAlignment);
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &this->uniformAlignment);
+
+		this->createStorage();
+	}
+
+	~StreamBuffer(){
+		for(unsigned i = 0; i < this->nrOfRegions; i++){
+			if(this->fences[i]){
+				glDeleteSync(this->fences[i]);
+			}
+		}
+		delete[] this->fences;
+
+		this->deleteStorage();
+	}
+
+	//Accessors
+	inline GLuint getBuffer() const{return this->buffer;}
+	inline GLsizeiptr getRegionSize() const{return this->regionSize;}
+	inline GLint getStorageAlignment() const{return this->storageAlignment;}
+	inline GLint getUniformAlignment() const{return this->uniformAlignment;}
+
+	//Functions
+
+	// Move on to the next region, blocks only if the GPU is still nrOfRegions frames behind.
+	// After a frame that didn't fit it waits for all regions and grows them.
+	void beginFrame(){
+		if(this->missing > 0){
+			this->grow(this->head + this->missing);
+			this->missing = 0;
+		}
+		this->region = (this->region + 1) % this->nrOfRegions;
+		this->head = 0;
+		this->waitForFence(this->fences[this->region]);
+	}
+
+	// Fence all commands that read from the region of this frame
+	void endFrame(){
+		if(this->fences[this->region]){
+			glDeleteSync(this->fences[this->region]);
+		}
+		this->fences[this->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+	// Reserve size bytes in the current region, data is nullptr if the region is full.
+	// The first failure of a frame is reported, the regions grow to fit the whole frame at the next beginFrame().
+	StreamAllocation allocate(GLsizeiptr size, GLsizeiptr alignment = 16){
+		StreamAllocation allocation = {0, size, nullptr};
+		GLsizeiptr start = (this->head + alignment - 1) / alignment * alignment;
+		if(start + size > this->regionSize){
+			if(this->missing == 0){
+				std::cout << "ERROR::STREAMBUFFER::REGION_FULL: " << size << " bytes requested, " << this->regionSize - this->head
+					<< " left, growing next frame" << "\n";
+			}
+			this->missing += size + alignment;
+			return allocation;
+		}
+		this->head = start + size;
+		allocation.offset = this->region * this->regionSize + start;
+		allocation.data = this->mapped + allocation.offset;
+		return allocation;
+	}
+
+	// Allocate and copy in one go
+	StreamAllocation upload(const void* data, GLsizeiptr size, GLsizeiptr alignment = 16){
+		StreamAllocation allocation = this->allocate(size, alignment);
+		if(allocation.data){
+			std::memcpy(allocation.data, data, size);
+		}
+		return allocation;
+	}
+
+	// Bind an allocation to an indexed target such as GL_SHADER_STORAGE_BUFFER or GL_UNIFORM_BUFFER
+	void bindRange(GLenum target, GLuint index, const StreamAllocation& allocation){
+		glBindBufferRange(target, index, this->buffer, allocation.offset, allocation.size);
+	}
+};
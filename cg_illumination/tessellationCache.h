@@ -0,0 +1,204 @@
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+
+#include <glad/glad.h>
+
+#include "shader.h"
+#include "mesh.h"
+#include "transformBatch.h"
+#include "atomicCounter.h"
+
+// Keeps the tessellated surface of a patch mesh so it is only generated when its inputs change.
+// Levels and culling depend on the view, so a recorded surface is only valid for the model-view-projection it was
+// tessellated with. While that changes from frame to frame the patches are tessellated live with the patch
+// program. Once it holds still for a frame the tessellation program runs once more with CAPTURE defined
+// (see main.tes.glsl): rasterization is switched off and transform feedback records the triangles in model space.
+// Until the view, the mesh or the triangle size change again, every frame draws that buffer with
+// glDrawTransformFeedback through a pass-through vertex shader (main.vert_cached.glsl).
+class TessellationCache{
+private:
+	static const GLsizeiptr VERTEX_SIZE = 32;    // vec3 position, vec3 normal, vec2 texture coordinate
+
+	GLuint feedback;
+	GLuint buffer;
+	GLuint VAO;
+	GLsizeiptr capacity;
+	GLuint queries[2];                          // Primitives generated and written, to detect a full buffer
+
+	const Mesh* mesh;
+	GLfloat triangleSize;
+	glm::mat4 capturedTransform;                // Model-view-projection of the capture
+	glm::mat4 lastTransform;                    // Model-view-projection of the previous frame
+	bool valid;
+
+	unsigned long long cachedFrames;
+	unsigned long long capturedFrames;
+	unsigned long long liveFrames;
+
+	static void setTransform(Shader* shader, const DrawTransform& transform){
+		shader->setMat4fv(transform.model, "model");
+		shader->setMat4fv(transform.mvp, "mvp");
+		shader->setMat3fv(glm::mat3(transform.normalMatrix), "normalMatrix");
+	}
+
+	void allocate(GLsizeiptr capacity){
+		this->capacity = capacity;
+		glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, this->buffer);
+		glBufferData(GL_TRANSFORM_FEEDBACK_BUFFER, capacity, NULL, GL_STATIC_DRAW);
+		glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, 0);
+	}
+
+	// Returns false if the buffer was too small, it is grown to fit for the next try
+	bool capture(Mesh* mesh, Shader* captureShader){
+		captureShader->Use();
+		glEnable(GL_RASTERIZER_DISCARD);
+		glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, this->feedback);
+		glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, this->buffer);
+
+		glBeginQuery(GL_PRIMITIVES_GENERATED, this->queries[0]);
+		glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, this->queries[1]);
+		glBeginTransformFeedback(GL_TRIANGLES);
+		mesh->draw(GL_PATCHES);
+		glEndTransformFeedback();
+		glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+		glEndQuery(GL_PRIMITIVES_GENERATED);
+
+		glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+		glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, 0);
+		glDisable(GL_RASTERIZER_DISCARD);
+		glUseProgram(0);
+
+		// Only read on capture frames, the wait is part of the cost of tessellating
+		GLuint generated = 0;
+		GLuint written = 0;
+		glGetQueryObjectuiv(this->queries[0], GL_QUERY_RESULT, &generated);
+		glGetQueryObjectuiv(this->queries[1], GL_QUERY_RESULT, &written);
+		if(generated > written){
+			this->allocate((GLsizeiptr)generated * 3 * VERTEX_SIZE * 5 / 4);
+			return false;
+		}
+		return true;
+	}
+
+public:
+	TessellationCache(GLsizeiptr capacity = 16 << 20){
+		glGenTransformFeedbacks(1, &this->feedback);
+		glGenBuffers(1, &this->buffer);
+		glGenQueries(2, this->queries);
+		this->allocate(capacity);
+
+		// Same attribute locations as Vertex, color is constant
+		glGenVertexArrays(1, &this->VAO);
+		glBindVertexArray(this->VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, this->buffer);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, VERTEX_SIZE, (GLvoid*)0);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, VERTEX_SIZE, (GLvoid*)12);
+		glEnableVertexAttribArray(3);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, VERTEX_SIZE, (GLvoid*)24);
+		glEnableVertexAttribArray(2);
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		this->mesh = nullptr;
+		this->triangleSize = 0.f;
+		this->capturedTransform = glm::mat4(0.f);
+		this->lastTransform = glm::mat4(0.f);
+		this->valid = false;
+		this->cachedFrames = 0;
+		this->capturedFrames = 0;
+		this->liveFrames = 0;
+	}
+
+	~TessellationCache(){
+		glDeleteVertexArrays(1, &this->VAO);
+		glDeleteQueries(2, this->queries);
+		glDeleteBuffers(1, &this->buffer);
+		glDeleteTransformFeedbacks(1, &this->feedback);
+	}
+
+	//Accessors
+	inline bool isValid() const{return this->valid;}
+	inline GLsizeiptr getCapacity() const{return this->capacity;}
+	inline unsigned long long getCachedFrames() const{return this->cachedFrames;}
+	inline unsigned long long getCapturedFrames() const{return this->capturedFrames;}
+	inline unsigned long long getLiveFrames() const{return this->liveFrames;}
+
+	//Functions
+
+	// The next render() tessellates again, e.g. after the control points were edited
+	void invalidate(){
+		this->valid = false;
+	}
+
+	// Draw the patches of mesh. patchShader (the patch program) tessellates them live while the view moves,
+	// captureShader (the patch program built with CAPTURE) records them once it holds still and drawShader
+	// (main.vert_cached.glsl) draws the recording. All three need their view projection and the other uniforms
+	// of the patch program set by the caller. culledPatches counts the patches culled by the tessellating frames.
+	void render(Mesh* mesh, Shader* patchShader, Shader* captureShader, Shader* drawShader, GLfloat triangleSize,
+		AtomicCounter* culledPatches = nullptr){
+		glm::mat4 model = mesh->getModelMatrix();
+		DrawTransform transform;
+		computeDrawTransforms(patchShader->getViewProjection(), &model, &transform, 1);
+		bool moving = transform.mvp != this->lastTransform;
+		this->lastTransform = transform.mvp;
+
+		bool current = this->valid && mesh == this->mesh && triangleSize == this->triangleSize
+			&& transform.mvp == this->capturedTransform;
+		if(current){
+			this->cachedFrames++;
+			if(culledPatches){
+				culledPatches->update();
+			}
+		}else if(moving){
+			setTransform(patchShader, transform);
+			patchShader->set1f(triangleSize, "triangleSize");
+			if(culledPatches){
+				culledPatches->begin();
+			}
+			patchShader->Use();
+			mesh->draw(GL_PATCHES);
+			glUseProgram(0);
+			if(culledPatches){
+				culledPatches->end();
+			}
+			this->liveFrames++;
+			return;
+		}else{
+			setTransform(captureShader, transform);
+			captureShader->set1f(triangleSize, "triangleSize");
+
+			if(culledPatches){
+				culledPatches->begin();
+			}
+			this->valid = this->capture(mesh, captureShader);
+			if(!this->valid){
+				// The buffer was grown, only the patches of the second try are counted
+				if(culledPatches){
+					culledPatches->begin();
+				}
+				this->valid = this->capture(mesh, captureShader);
+			}
+			if(culledPatches){
+				culledPatches->end();
+			}
+			if(!this->valid){
+				std::cout << "ERROR::TESSELLATIONCACHE::CAPTURE_FAILED" << "\n";
+				return;
+			}
+			this->mesh = mesh;
+			this->triangleSize = triangleSize;
+			this->capturedTransform = transform.mvp;
+			this->capturedFrames++;
+		}
+
+		setTransform(drawShader, transform);
+		drawShader->Use();
+		glBindVertexArray(this->VAO);
+		glDrawTransformFeedback(GL_TRIANGLES, this->feedback);
+		glBindVertexArray(0);
+		glUseProgram(0);
+	}
+};
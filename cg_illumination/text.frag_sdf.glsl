@@ -0,0 +1,15 @@
+#version 330 core
+in vec2 TexCoords;
+in vec4 GlyphColor;
+out vec4 color;
+
+uniform sampler2D text;
+uniform vec3 textColor;
+
+void main(){
+    // distance field: 0.5 is the outline, the screen space derivative keeps edges one pixel wide at any scale
+    float distance = texture(text, TexCoords).r;
+    float width = fwidth(distance);
+    float alpha = smoothstep(0.5 - width, 0.5 + width, distance);
+    color = vec4(textColor * GlyphColor.rgb, alpha * GlyphColor.a);
+}
\ No newline at end of file
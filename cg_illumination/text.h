@@ -1,28 +1,26 @@
 #pragma once
-#include <map>
+#include <cstring>
 
+#include "streamBuffer.h"
+#include "fontAtlas.h"
+
+// Renders strings from a signed distance field atlas, draw with text.vert.glsl and text.frag_sdf.glsl.
+// One atlas serves all scales, scale 1 draws glyphs at the pixel size the atlas was built for.
 class Text{
 private:
-	struct Character {
-		GLuint texture;   // ID handle of the glyph texture
-		glm::ivec2 Size;    // Size of glyph
-		glm::ivec2 Bearing;  // Offset from baseline to left/top of glyph
-		GLuint Advance;    // Horizontal offset to advance to next glyph
-	};
-
-	std::map<GLchar, Character> characters;
+	FontAtlas* font;
+	GLuint atlas;
 
-	GLuint VAO, VBO;
+	GLuint VAO;
+	StreamBuffer* stream;
+	std::vector<FontAtlas::GlyphQuad> layoutQuads;
 
 	void initVAO(){
-		// Configure VAO/VBO for texture quads
+		// Configure VAO for texture quads, the vertices live in the shared stream buffer
 		glGenVertexArrays(1, &this->VAO);
 		glBindVertexArray(this->VAO);
 
-		glGenBuffers(1, &this->VBO);
-		glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 6 * 4, NULL, GL_DYNAMIC_DRAW);
-		
+		glBindBuffer(GL_ARRAY_BUFFER, this->stream->getBuffer());
 		glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), 0);
 		glEnableVertexAttribArray(0);
 
@@ -30,112 +28,92 @@ private:
 		glBindVertexArray(0);
 	}
 
-public:
-	Text(const char* fontPath){
-		// FreeType
-		FT_Library ft;
-		// All functions return a value different than 0 whenever an error occurred
-		if(FT_Init_FreeType(&ft))
-			std::cout << "ERROR::FREETYPE: Could not init FreeType Library" << std::endl;
-
-		// Load font as face
-		FT_Face face;
-		if(FT_New_Face(ft, fontPath, 0, &face))
-			std::cout << "ERROR::FREETYPE: Failed to load font" << std::endl;
-
-		// Set size to load glyphs as
-		FT_Set_Pixel_Sizes(face, 0, 48);
-
+	void initAtlas(){
 		// Disable byte-alignment restriction
 		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
-		// Load first 128 characters of ASCII set
-		for(GLubyte c = 0; c < 128; c++){
-			// Load character glyph
-			if(FT_Load_Char(face, c, FT_LOAD_RENDER)){
-				std::cout << "ERROR::FREETYTPE: Failed to load Glyph" << std::endl;
-				continue;
-			}
-			// Generate texture
-			GLuint texture;
-			glGenTextures(1, &texture);
-			glBindTexture(GL_TEXTURE_2D, texture);
-			glTexImage2D(
-				GL_TEXTURE_2D,
-				0,
-				GL_RED,
-				face->glyph->bitmap.width,
-				face->glyph->bitmap.rows,
-				0,
-				GL_RED,
-				GL_UNSIGNED_BYTE,
-				face->glyph->bitmap.buffer
-			);
-			// Set texture options
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-			
-			// Now store character for later use
-			Character character = {
-				texture,
-				glm::ivec2(face->glyph->bitmap.width, face->glyph->bitmap.rows),
-				glm::ivec2(face->glyph->bitmap_left, face->glyph->bitmap_top),
-				GLuint(face->glyph->advance.x)
-			};
-			this->characters.insert(std::pair<GLchar, Character>(c, character));
-		}
+		glGenTextures(1, &this->atlas);
+		glBindTexture(GL_TEXTURE_2D, this->atlas);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, this->font->getSize().x, this->font->getSize().y, 0, GL_RED, GL_UNSIGNED_BYTE, this->font->getImage());
+		// Set texture options, distance fields interpolate well so plain linear filtering is enough
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 		glBindTexture(GL_TEXTURE_2D, 0);
-		// Destroy FreeType once we're finished
-		FT_Done_Face(face);
-		FT_Done_FreeType(ft);
+	}
+
+public:
+	Text(const char* fontPath, StreamBuffer* stream, int pixelSize = 48, const std::vector<unsigned>& codepoints = FontAtlas::defaultCodepoints()){
+		this->stream = stream;
+
+		// Distance field atlas, generated once and then loaded from the disk cache
+		this->font = new FontAtlas(fontPath, pixelSize, codepoints);
 
+		this->initAtlas();
 		this->initVAO();
 	}
 
-	~Text(){}
-
-	void Render(Shader &shader, std::string text, GLfloat x, GLfloat y, GLfloat scale, glm::vec3 color){
-		// Activate corresponding render state
-		shader.Use();
-		shader.setVec3f(color, "textColor");
-		glActiveTexture(GL_TEXTURE0);
-		glBindVertexArray(VAO);
+	~Text(){
+		glDeleteVertexArrays(1, &this->VAO);
+		glDeleteTextures(1, &this->atlas);
+		delete this->font;
+	}
 
-		// Iterate through all characters
-		std::string::const_iterator c;
-		for(c = text.begin(); c != text.end(); c++){
-			Character ch = this->characters[*c];
+	//Accessors
+	inline const FontAtlas* getFont() const{return this->font;}
+	inline GLuint getAtlas() const{return this->atlas;}
+
+	// Builds the quads of the whole string into one batch and draws it with a single call.
+	// The string is UTF-8, '\n' starts a new line and a positive maxWidth wraps words.
+	void Render(Shader &shader, std::string text, GLfloat x, GLfloat y, GLfloat scale, glm::vec3 color, GLfloat maxWidth = 0.f){
+		this->layoutQuads.clear();
+		this->font->layout(text, x, y, scale, maxWidth, this->layoutQuads);
+		if(this->layoutQuads.empty()){
+			return;
+		}
 
-			GLfloat xpos = x + ch.Bearing.x * scale;
-			GLfloat ypos = y - (ch.Size.y - ch.Bearing.y) * scale;
+		// Reserve room for all quads of the string at once, vertices are 4 floats so offsets map to vertex indices
+		const GLsizeiptr vertexSize = 4 * sizeof(GLfloat);
+		StreamAllocation allocation = this->stream->allocate(this->layoutQuads.size() * 6 * vertexSize, vertexSize);
+		if(!allocation.data){
+			return;
+		}
+		GLfloat* quads = (GLfloat*)allocation.data;
 
-			GLfloat w = ch.Size.x * scale;
-			GLfloat h = ch.Size.y * scale;
-			// Update VBO for each character
+		for(auto& i : this->layoutQuads){
+			// Atlas rows go from the top of the glyph down
 			GLfloat vertices[6][4] = {
-				{ xpos,     ypos + h,   0.0, 1.0 },
-				{ xpos,     ypos,       0.0, 0.0 },
-				{ xpos + w, ypos,       1.0, 0.0 },
+				{ i.rect.x, i.rect.w,   i.uv.x, i.uv.y },
+				{ i.rect.x, i.rect.y,   i.uv.x, i.uv.w },
+				{ i.rect.z, i.rect.y,   i.uv.z, i.uv.w },
 
-				{ xpos,     ypos + h,   0.0, 1.0 },
-				{ xpos + w, ypos,       1.0, 0.0 },
-				{ xpos + w, ypos + h,   1.0, 1.0 }
+				{ i.rect.x, i.rect.w,   i.uv.x, i.uv.y },
+				{ i.rect.z, i.rect.y,   i.uv.z, i.uv.w },
+				{ i.rect.z, i.rect.w,   i.uv.z, i.uv.y }
 			};
-			// Render glyph texture over quad
-			glBindTexture(GL_TEXTURE_2D, ch.texture);
-			// Update content of VBO memory
-			glBindBuffer(GL_ARRAY_BUFFER, VBO);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices); // Be sure to use glBufferSubData and not glBufferData
-
-			glBindBuffer(GL_ARRAY_BUFFER, 0);
-			// Render quad
-			glDrawArrays(GL_TRIANGLES, 0, 6);
-			// Now advance cursors for next glyph (note that advance is number of 1/64 pixels)
-			x += (ch.Advance >> 6) * scale; // Bitshift by 6 to get value in pixels (2^6 = 64 (divide amount of 1/64th pixels by 64 to get amount of pixels))
+			// Write quad into the mapped stream buffer, no upload call needed
+			std::memcpy(quads, vertices, sizeof(vertices));
+			quads += 6 * 4;
 		}
+
+		// Activate corresponding render state
+		shader.setVec3f(color, "textColor");
+		shader.Use();
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, this->atlas);
+		glBindVertexArray(VAO);
+		// The stream buffer is replaced when it grows, point the VAO at the current one
+		glBindBuffer(GL_ARRAY_BUFFER, this->stream->getBuffer());
+		glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), 0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		// Immediate text has no per glyph color
+		glVertexAttrib4f(1, 1.f, 1.f, 1.f, 1.f);
+
+		// Render all quads at once
+		glDrawArrays(GL_TRIANGLES, (GLint)(allocation.offset / vertexSize), (GLsizei)this->layoutQuads.size() * 6);
+
 		glBindVertexArray(0);
 		glBindTexture(GL_TEXTURE_2D, 0);
 	}
-};
\ No newline at end of file
+};
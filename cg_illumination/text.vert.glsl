@@ -1,11 +1,14 @@
 #version 330 core
-layout (location = 0) in vec4 vertex; // <vec2 pos, vec2 tex>
+layout (location = 0) in vec4 vertex; // <vec2 pos, vec2 atlas tex>
+layout (location = 1) in vec4 vertexColor; // per glyph color of retained text blocks, constant 1 otherwise
 
 uniform mat4 projection;
 
 out vec2 TexCoords;
+out vec4 GlyphColor;
 
 void main(){
     gl_Position = projection * vec4(vertex.xy, 0.0, 1.0);
-    TexCoords = vec2(vertex.z, 1.0f - vertex.w);
+    TexCoords = vertex.zw;
+    GlyphColor = vertexColor;
 }
\ No newline at end of file
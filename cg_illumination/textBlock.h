@@ -0,0 +1,183 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstddef>
+
+#include "text.h"
+
+// Retained text for strings that rarely change, such as labels and HUD captions.
+// All labels of a block are laid out once into a vertex buffer owned by the block and drawn with one call,
+// the buffer is only rebuilt when a label actually changed, so static text costs no uploads per frame.
+// Draw with text.vert.glsl and text.frag_sdf.glsl, the textColor uniform tints the whole block.
+class TextBlock{
+private:
+	struct Label{
+		std::string text;
+		glm::vec2 position;
+		GLfloat scale;
+		glm::vec4 color;
+		GLfloat maxWidth;
+		bool visible;
+	};
+
+	// vec4 position/texture coordinates, vec4 color
+	struct GlyphVertex{
+		glm::vec4 vertex;
+		glm::vec4 color;
+	};
+
+	Text* text;
+	std::vector<Label> labels;
+	bool dirty;
+
+	GLuint VAO;
+	GLuint VBO;
+	GLsizeiptr capacity;
+	GLsizei nrOfVertices;
+
+	std::vector<FontAtlas::GlyphQuad> quads;
+	std::vector<GlyphVertex> vertices;
+
+	void initVAO(){
+		glGenVertexArrays(1, &this->VAO);
+		glGenBuffers(1, &this->VBO);
+		glBindVertexArray(this->VAO);
+
+		glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
+		glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(GlyphVertex), (GLvoid*)offsetof(GlyphVertex, vertex));
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(GlyphVertex), (GLvoid*)offsetof(GlyphVertex, color));
+		glEnableVertexAttribArray(1);
+
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindVertexArray(0);
+	}
+
+	// Lay out every visible label and replace the contents of the vertex buffer
+	void rebuild(){
+		this->vertices.clear();
+		for(auto& i : this->labels){
+			if(!i.visible){
+				continue;
+			}
+			this->quads.clear();
+			this->text->getFont()->layout(i.text, i.position.x, i.position.y, i.scale, i.maxWidth, this->quads);
+			for(auto& q : this->quads){
+				// Atlas rows go from the top of the glyph down
+				this->vertices.push_back({glm::vec4(q.rect.x, q.rect.w, q.uv.x, q.uv.y), i.color});
+				this->vertices.push_back({glm::vec4(q.rect.x, q.rect.y, q.uv.x, q.uv.w), i.color});
+				this->vertices.push_back({glm::vec4(q.rect.z, q.rect.y, q.uv.z, q.uv.w), i.color});
+
+				this->vertices.push_back({glm::vec4(q.rect.x, q.rect.w, q.uv.x, q.uv.y), i.color});
+				this->vertices.push_back({glm::vec4(q.rect.z, q.rect.y, q.uv.z, q.uv.w), i.color});
+				this->vertices.push_back({glm::vec4(q.rect.z, q.rect.w, q.uv.z, q.uv.y), i.color});
+			}
+		}
+		this->nrOfVertices = (GLsizei)this->vertices.size();
+
+		GLsizeiptr size = this->vertices.size() * sizeof(GlyphVertex);
+		glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
+		if(size > this->capacity){
+			// Grow with headroom so small edits don't reallocate every time
+			this->capacity = size + size / 2;
+			glBufferData(GL_ARRAY_BUFFER, this->capacity, NULL, GL_STATIC_DRAW);
+		}
+		if(size > 0){
+			glBufferSubData(GL_ARRAY_BUFFER, 0, size, this->vertices.data());
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		this->dirty = false;
+	}
+
+public:
+	TextBlock(Text* text){
+		this->text = text;
+		this->dirty = false;
+		this->capacity = 0;
+		this->nrOfVertices = 0;
+		this->initVAO();
+	}
+
+	~TextBlock(){
+		glDeleteVertexArrays(1, &this->VAO);
+		glDeleteBuffers(1, &this->VBO);
+	}
+
+	//Accessors
+	inline size_t getNrOfLabels() const{return this->labels.size();}
+	inline GLsizei getNrOfVertices() const{return this->nrOfVertices;}
+	inline const std::string& getText(size_t label) const{return this->labels[label].text;}
+
+	//Modifiers, only a real change marks the block for rebuilding
+	void setText(size_t label, const std::string& text){
+		if(this->labels[label].text != text){
+			this->labels[label].text = text;
+			this->dirty = true;
+		}
+	}
+
+	void setPosition(size_t label, const glm::vec2& position){
+		if(this->labels[label].position != position){
+			this->labels[label].position = position;
+			this->dirty = true;
+		}
+	}
+
+	void setScale(size_t label, GLfloat scale){
+		if(this->labels[label].scale != scale){
+			this->labels[label].scale = scale;
+			this->dirty = true;
+		}
+	}
+
+	void setColor(size_t label, const glm::vec4& color){
+		if(this->labels[label].color != color){
+			this->labels[label].color = color;
+			this->dirty = true;
+		}
+	}
+
+	void setVisible(size_t label, bool visible){
+		if(this->labels[label].visible != visible){
+			this->labels[label].visible = visible;
+			this->dirty = true;
+		}
+	}
+
+	//Functions
+
+	// Returns the index used to modify the label later, text is UTF-8 and may contain '\n'
+	size_t addLabel(const std::string& text, const glm::vec2& position, GLfloat scale = 1.f,
+		const glm::vec4& color = glm::vec4(1.f), GLfloat maxWidth = 0.f){
+		this->labels.push_back({text, position, scale, color, maxWidth, true});
+		this->dirty = true;
+		return this->labels.size() - 1;
+	}
+
+	void clear(){
+		this->labels.clear();
+		this->dirty = true;
+	}
+
+	// Rebuilds the vertex buffer if something changed, then draws all labels with a single call
+	void Render(Shader &shader){
+		if(this->dirty){
+			this->rebuild();
+		}
+		if(this->nrOfVertices == 0){
+			return;
+		}
+
+		shader.Use();
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, this->text->getAtlas());
+		glBindVertexArray(this->VAO);
+
+		glDrawArrays(GL_TRIANGLES, 0, this->nrOfVertices);
+
+		glBindVertexArray(0);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+};
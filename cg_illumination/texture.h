@@ -2,73 +2,150 @@
 
 #include<iostream>
 #include<string>
+#include<vector>
+#include<algorithm>
 
 //#include<glew.h>
 #include<GLFW/glfw3.h>
 
 #include<SOIL.h>
 
+#include "textureCompressor.h"
+#include "mipGenerator.h"
+
+// Anisotropic filtering is core since 4.6, older headers only know the extension names
+#ifndef GL_TEXTURE_MAX_ANISOTROPY
+#define GL_TEXTURE_MAX_ANISOTROPY 0x84FE
+#endif
+#ifndef GL_MAX_TEXTURE_MAX_ANISOTROPY
+#define GL_MAX_TEXTURE_MAX_ANISOTROPY 0x84FF
+#endif
+
+// 2D texture on immutable storage (glTexStorage2D) with a complete mip chain, sampled trilinearly and
+// with the highest anisotropy the driver allows. Mips come from glGenerateMipmap or, when a CPU filter is
+// requested, from MipGenerator, which also filters sRGB images in linear light.
 class Texture{
 private:
 	GLuint id;
 	int width;
 	int height;
 	unsigned int type;
+	GLenum internalFormat;
+	GLsizei nrOfLevels;
+	MipGenerator::Filter mipFilter;
 
-public:
-	Texture(){
+	// Allocate all levels at once, the storage can't be resized afterwards
+	void createStorage(GLenum internalFormat, int width, int height, GLsizei nrOfLevels){
+		this->width = width;
+		this->height = height;
+		this->internalFormat = internalFormat;
+		this->nrOfLevels = nrOfLevels;
 
-	}
+		// All upcoming operations now effect this texture object
+		glGenTextures(1, &this->id);
+		glBindTexture(this->type, this->id);
+		glTexStorage2D(this->type, nrOfLevels, internalFormat, width, height);
 
-	Texture(const char* fileName, GLenum type){
-		this->type = type;
+		// Set wrapping to repeat, minification blends between mip levels, magnification has only level 0
+		glTexParameteri(this->type, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(this->type, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(this->type, GL_TEXTURE_MIN_FILTER, nrOfLevels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTexParameteri(this->type, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(this->type, GL_TEXTURE_MAX_LEVEL, nrOfLevels - 1);
 
-		// Load image
-		unsigned char* image = SOIL_load_image(fileName, &this->width, &this->height, NULL, SOIL_LOAD_RGBA);
-		std::cout << this->width << "\t" << this->height << std::endl;
+		GLfloat anisotropy = 1.f;
+		glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &anisotropy);
+		glTexParameterf(this->type, GL_TEXTURE_MAX_ANISOTROPY, std::min(std::max(anisotropy, 1.f), 16.f));
+	}
 
-		// All upcoming operations now effect this texture object
-		glGenTextures(1, &this->id);
-		glBindTexture(type, this->id);
+	// Fill every level of the bound texture from an RGBA8 image
+	void uploadLevels(const unsigned char* image){
+		if(this->mipFilter == MipGenerator::GPU){
+			glTexSubImage2D(this->type, 0, 0, 0, this->width, this->height, GL_RGBA, GL_UNSIGNED_BYTE, image);
+			glGenerateMipmap(this->type);
+			return;
+		}
 
-		// Set wrapping to repeat and filtering to linear
-		glTexParameteri(type, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(type, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(type, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(type, GL_TEXTURE_MAG_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		std::vector<std::vector<unsigned char>> levels;
+		std::vector<glm::ivec2> sizes;
+		MipGenerator::generate(image, this->width, this->height, this->mipFilter, this->internalFormat == GL_SRGB8_ALPHA8, levels, sizes);
+		for(size_t i = 0; i < levels.size(); i++){
+			glTexSubImage2D(this->type, (GLint)i, 0, 0, sizes[i].x, sizes[i].y, GL_RGBA, GL_UNSIGNED_BYTE, levels[i].data());
+		}
+	}
 
-		// Create texture and mipmaps
+	void loadImage(const char* fileName, bool srgb){
+		// Load image
+		int width = 0;
+		int height = 0;
+		unsigned char* image = SOIL_load_image(fileName, &width, &height, NULL, SOIL_LOAD_RGBA);
+
+		// Create texture and mipmaps, a missing image leaves a 1x1 texture behind
 		if(image){
-			glTexImage2D(type, 0, GL_RGBA, this->width, this->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-			glGenerateMipmap(type);
+			this->createStorage(srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8, width, height, MipGenerator::getNrOfLevels(width, height));
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+			this->uploadLevels(image);
 		}else{
 			std::cout << "ERROR::TEXTURE::TEXTURE_LOADING_FAILED: " << fileName << "\n";
+			this->createStorage(GL_RGBA8, 1, 1, 1);
 		}
 
 		// Activate texture and unbind
-		glActiveTexture(0);
-		glBindTexture(type, 0);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(this->type, 0);
 		SOIL_free_image_data(image);
 	}
 
-	Texture(GLenum type, int color, int width, int height, unsigned char* image){
+public:
+	Texture(){
+		this->id = 0;
+		this->width = 0;
+		this->height = 0;
+		this->type = GL_TEXTURE_2D;
+		this->internalFormat = GL_RGBA8;
+		this->nrOfLevels = 0;
+		this->mipFilter = MipGenerator::GPU;
+	}
+
+	// srgb marks color images, they are stored as GL_SRGB8_ALPHA8 and CPU mips are filtered in linear light
+	Texture(const char* fileName, GLenum type, MipGenerator::Filter mipFilter = MipGenerator::GPU, bool srgb = false){
 		this->type = type;
+		this->mipFilter = mipFilter;
+		this->loadImage(fileName, srgb);
+	}
 
-		// All upcoming operations now effect this texture object
-		glGenTextures(1, &this->id);
-		glBindTexture(type, this->id);
+	// Block compressed texture, the mip chain is baked once and then loaded from the cache
+	Texture(const char* fileName, GLenum type, TextureCompressor::Format format){
+		this->type = type;
+		this->mipFilter = MipGenerator::GPU;
 
-		// Set wrapping to repeat and filtering to linear
-		glTexParameteri(type, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(type, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(type, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(type, GL_TEXTURE_MAG_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		CompressedImage compressed;
+		if(TextureCompressor::load(fileName, format, compressed)){
+			this->createStorage(compressed.internalFormat, compressed.sizes[0].x, compressed.sizes[0].y, (GLsizei)compressed.levels.size());
+			// Upload the blocks of every level as they are, no mipmap generation needed
+			for(size_t i = 0; i < compressed.levels.size(); i++){
+				glCompressedTexSubImage2D(type, (GLint)i, 0, 0, compressed.sizes[i].x, compressed.sizes[i].y, compressed.internalFormat,
+					(GLsizei)compressed.levels[i].size(), compressed.levels[i].data());
+			}
+		}else{
+			std::cout << "ERROR::TEXTURE::TEXTURE_LOADING_FAILED: " << fileName << "\n";
+			this->createStorage(GL_RGBA8, 1, 1, 1);
+		}
 
-		glTexImage2D(type, 0, color, this->width, this->height, 0, color, GL_UNSIGNED_BYTE, image);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(type, 0);
+	}
+
+	Texture(GLenum type, int color, int width, int height, unsigned char* image){
+		this->type = type;
+		this->mipFilter = MipGenerator::GPU;
+
+		this->createStorage(color == GL_RGB ? GL_RGB8 : GL_RGBA8, width, height, MipGenerator::getNrOfLevels(width, height));
+		glTexSubImage2D(type, 0, 0, 0, width, height, color, GL_UNSIGNED_BYTE, image);
 		glGenerateMipmap(type);
 
 		// Activate texture and unbind
-		glActiveTexture(0);
+		glActiveTexture(GL_TEXTURE0);
 		glBindTexture(type, 0);
 	}
 
@@ -77,6 +154,33 @@ public:
 	}
 
 	inline GLuint getID() const{return this->id;}
+	inline GLenum getInternalFormat() const{return this->internalFormat;}
+
+	// Estimated video memory of all levels in bytes
+	size_t getMemorySize() const{
+		size_t size = 0;
+		int w = this->width;
+		int h = this->height;
+		for(GLsizei i = 0; i < this->nrOfLevels; i++){
+			size_t blocks = (size_t)((w + 3) / 4) * ((h + 3) / 4);
+			switch(this->internalFormat){
+				case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+					size += blocks * 8;
+					break;
+				case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+				case GL_COMPRESSED_RG_RGTC2:
+				case GL_COMPRESSED_RGBA_BPTC_UNORM:
+					size += blocks * 16;
+					break;
+				default:
+					size += (size_t)w * h * 4;
+					break;
+			}
+			w = std::max(1, w / 2);
+			h = std::max(1, h / 2);
+		}
+		return size;
+	}
 
 	glm::vec2 getSize(){
 		return glm::vec2(this->width, this->height);
@@ -96,34 +200,60 @@ public:
 	}
 
 	void unbind(){
-		glActiveTexture(0);
+		glActiveTexture(GL_TEXTURE0);
 		glBindTexture(this->type, 0);
 	}
 
-	void loadFromFile(const char* fileName){
-		if(this->id){
+	// Replace the image of the texture, the storage is immutable so a new texture id is created when the size
+	// changes. Materials keep pointing at this object and pick up the new id on their next bind.
+	// With a GL_PIXEL_UNPACK_BUFFER bound, pixels is an offset into that buffer and mips are generated on the GPU.
+	void setImage(int width, int height, const void* pixels){
+		if(this->id == 0 || width != this->width || height != this->height){
 			glDeleteTextures(1, &this->id);
+			this->createStorage(this->internalFormat, width, height, MipGenerator::getNrOfLevels(width, height));
+		}else{
+			glBindTexture(this->type, this->id);
 		}
+		glTexSubImage2D(this->type, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+		glGenerateMipmap(this->type);
+		glBindTexture(this->type, 0);
+	}
 
-		unsigned char* image = SOIL_load_image(fileName, &this->width, &this->height, NULL, SOIL_LOAD_RGBA);
+	inline GLsizei getNrOfLevels() const{return this->nrOfLevels;}
 
-		glGenTextures(1, &this->id);
-		glBindTexture(this->type, this->id);
+	// Recreate the storage with a new top level size, both chains end at 1x1 so the levels the old and new
+	// storage share are copied over on the GPU. Levels above the old top level are left for uploadLevel.
+	void resizeStorage(int width, int height){
+		GLuint old = this->id;
+		int oldWidth = this->width;
+		int oldHeight = this->height;
+		GLsizei oldLevels = this->nrOfLevels;
+		GLsizei nrOfLevels = MipGenerator::getNrOfLevels(width, height);
 
-		glTexParameteri(this->type, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(this->type, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(this->type, GL_TEXTURE_MAG_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(this->type, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-
-		if(image){
-			glTexImage2D(this->type, 0, GL_RGBA, this->width, this->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-			glGenerateMipmap(this->type);
-		}else{
-			std::cout << "ERROR::TEXTURE::LOADFROMFILE::TEXTURE_LOADING_FAILED: " << fileName << "\n";
+		this->createStorage(this->internalFormat, width, height, nrOfLevels);
+		GLsizei offset = nrOfLevels - oldLevels;
+		for(GLsizei level = std::max(0, -offset); old && level < oldLevels && level + offset < nrOfLevels; level++){
+			glCopyImageSubData(old, this->type, level, 0, 0, 0, this->id, this->type, level + offset, 0, 0, 0,
+				std::max(1, oldWidth >> level), std::max(1, oldHeight >> level), 1);
 		}
+		glBindTexture(this->type, 0);
+		glDeleteTextures(1, &old);
+	}
 
-		glActiveTexture(0);
+	// Fill one level from RGBA8 pixels
+	void uploadLevel(GLint level, const unsigned char* pixels){
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glBindTexture(this->type, this->id);
+		glTexSubImage2D(this->type, level, 0, 0, std::max(1, this->width >> level), std::max(1, this->height >> level),
+			GL_RGBA, GL_UNSIGNED_BYTE, pixels);
 		glBindTexture(this->type, 0);
-		SOIL_free_image_data(image);
 	}
-};
\ No newline at end of file
+
+	void loadFromFile(const char* fileName){
+		if(this->id){
+			glDeleteTextures(1, &this->id);
+			this->id = 0;
+		}
+		this->loadImage(fileName, this->internalFormat == GL_SRGB8_ALPHA8);
+	}
+};
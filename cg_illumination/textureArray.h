@@ -0,0 +1,159 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+
+#include <glad/glad.h>
+#include <SOIL.h>
+
+#include "mipGenerator.h"
+
+// Same sized RGBA8 textures stacked as layers of one GL_TEXTURE_2D_ARRAY with a full mip chain.
+// Everything sampling from the array needs a single bind, objects only differ by the layer index.
+class TextureArray{
+private:
+	GLuint id;
+	int width;
+	int height;
+	GLsizei capacity;
+	GLsizei nrOfLayers;
+	GLsizei nrOfLevels;
+	bool srgb;
+	MipGenerator::Filter mipFilter;
+
+public:
+	TextureArray(int width, int height, GLsizei capacity, bool srgb = false, MipGenerator::Filter mipFilter = MipGenerator::BOX){
+		this->width = width;
+		this->height = height;
+		this->capacity = capacity;
+		this->nrOfLayers = 0;
+		this->nrOfLevels = MipGenerator::getNrOfLevels(width, height);
+		this->srgb = srgb;
+		this->mipFilter = mipFilter == MipGenerator::GPU ? MipGenerator::BOX : mipFilter;
+
+		glGenTextures(1, &this->id);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, this->id);
+		glTexStorage3D(GL_TEXTURE_2D_ARRAY, this->nrOfLevels, srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8, width, height, capacity);
+
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	}
+
+	~TextureArray(){
+		glDeleteTextures(1, &this->id);
+	}
+
+	//Accessors
+	inline GLuint getID() const{return this->id;}
+	inline int getWidth() const{return this->width;}
+	inline int getHeight() const{return this->height;}
+	inline bool isSRGB() const{return this->srgb;}
+	inline GLsizei getNrOfLayers() const{return this->nrOfLayers;}
+	inline GLsizei getCapacity() const{return this->capacity;}
+	inline bool isFull() const{return this->nrOfLayers >= this->capacity;}
+
+	//Functions
+
+	// Copies an RGBA8 image of the array size into the next free layer, mips are filtered on the CPU.
+	// Returns the layer index or -1 if the image doesn't fit.
+	GLint add(const unsigned char* image, int width, int height){
+		if(width != this->width || height != this->height || this->isFull()){
+			return -1;
+		}
+
+		std::vector<std::vector<unsigned char>> levels;
+		std::vector<glm::ivec2> sizes;
+		MipGenerator::generate(image, width, height, this->mipFilter, this->srgb, levels, sizes);
+
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, this->id);
+		for(size_t i = 0; i < levels.size(); i++){
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint)i, 0, 0, this->nrOfLayers, sizes[i].x, sizes[i].y, 1,
+				GL_RGBA, GL_UNSIGNED_BYTE, levels[i].data());
+		}
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+		return this->nrOfLayers++;
+	}
+
+	void bind(const GLint texture_unit){
+		glActiveTexture(GL_TEXTURE0 + texture_unit);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, this->id);
+	}
+
+	void unbind(){
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	}
+};
+
+// Where a packed texture ended up
+struct TextureLayer{
+	TextureArray* array;
+	GLint layer;
+};
+
+// Sorts image files into texture arrays by size and color space, creating arrays as they fill up.
+// The same file is only packed once.
+class TexturePacker{
+private:
+	std::vector<TextureArray*> arrays;
+	std::unordered_map<std::string, TextureLayer> layers;
+	GLsizei layersPerArray;
+
+public:
+	TexturePacker(GLsizei layersPerArray = 64){
+		this->layersPerArray = layersPerArray;
+	}
+
+	~TexturePacker(){
+		for(auto& i : this->arrays){
+			delete i;
+		}
+	}
+
+	//Accessors
+	inline size_t getNrOfArrays() const{return this->arrays.size();}
+	inline TextureArray* getArray(size_t index){return this->arrays[index];}
+
+	//Functions
+
+	// Returns the array and layer holding the file, array is nullptr if the file could not be loaded
+	TextureLayer add(const char* fileName, bool srgb = false){
+		std::string key = std::string(fileName) + (srgb ? "|srgb" : "");
+		auto it = this->layers.find(key);
+		if(it != this->layers.end()){
+			return it->second;
+		}
+
+		TextureLayer result = {nullptr, -1};
+		int width;
+		int height;
+		unsigned char* image = SOIL_load_image(fileName, &width, &height, NULL, SOIL_LOAD_RGBA);
+		if(!image){
+			std::cout << "ERROR::TEXTUREPACKER::TEXTURE_LOADING_FAILED: " << fileName << "\n";
+			return result;
+		}
+
+		for(auto& i : this->arrays){
+			if(i->getWidth() == width && i->getHeight() == height && i->isSRGB() == srgb && !i->isFull()){
+				result.array = i;
+				break;
+			}
+		}
+		if(!result.array){
+			result.array = new TextureArray(width, height, this->layersPerArray, srgb);
+			this->arrays.push_back(result.array);
+		}
+		result.layer = result.array->add(image, width, height);
+		SOIL_free_image_data(image);
+
+		this->layers[key] = result;
+		return result;
+	}
+};
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <list>
+#include <unordered_map>
+
+#include "texture.h"
+#include "textureLoader.h"
+#include "textureStreamer.h"
+
+// How a texture is created from its file, part of the cache key
+struct TextureParameters{
+	MipGenerator::Filter mipFilter;
+	bool srgb;
+	bool compressed;
+	TextureCompressor::Format format;
+	bool streamed;                          // Mip levels are streamed in by a TextureStreamer
+
+	TextureParameters(MipGenerator::Filter mipFilter = MipGenerator::GPU, bool srgb = false){
+		this->mipFilter = mipFilter;
+		this->srgb = srgb;
+		this->compressed = false;
+		this->format = TextureCompressor::BC1;
+		this->streamed = false;
+	}
+
+	TextureParameters(TextureCompressor::Format format){
+		this->mipFilter = MipGenerator::GPU;
+		this->srgb = false;
+		this->compressed = true;
+		this->format = format;
+		this->streamed = false;
+	}
+
+	static TextureParameters stream(){
+		TextureParameters parameters;
+		parameters.streamed = true;
+		return parameters;
+	}
+};
+
+// Shares textures between everything that loads the same file with the same parameters.
+// acquire() hands out the cached texture and counts references, release() gives one back. Textures nobody
+// references stay resident so loading them again is free, until the estimated video memory of all cached
+// textures exceeds the budget; then the least recently used unreferenced textures are deleted first.
+// With a TextureLoader, plain textures are decoded asynchronously and start out as placeholders. Streamed textures
+// belong to the TextureStreamer, which keeps them within its own budget, so they are neither counted nor deleted here. Eviction waits
+// until the loader is idle, call update() once per frame after TextureLoader::update() to run the postponed pass.
+class TextureCache{
+private:
+	struct Entry{
+		Texture* texture;
+		unsigned references;
+		size_t memorySize;
+		bool streamed;
+		std::list<std::string>::iterator recent;
+	};
+
+	std::unordered_map<std::string, Entry> entries;
+	std::unordered_map<const Texture*, std::string> keys;
+	std::list<std::string> recent;          // Most recently used first
+	size_t budget;
+	size_t memorySize;
+	TextureLoader* loader;
+	TextureStreamer* streamer;
+	bool evictionPostponed;                 // An eviction pass was skipped while loads were pending
+
+	static std::string makeKey(const std::string& fileName, const TextureParameters& parameters){
+		std::stringstream key;
+		key << fileName << "|" << (int)parameters.mipFilter << "|" << parameters.srgb << "|"
+			<< (parameters.compressed ? (int)parameters.format : -1) << "|" << parameters.streamed;
+		return key.str();
+	}
+
+	Texture* create(const std::string& fileName, const TextureParameters& parameters){
+		if(parameters.streamed && this->streamer){
+			return this->streamer->load(fileName.c_str());
+		}
+		if(parameters.streamed){
+			std::cout << "ERROR::TEXTURECACHE::NO_STREAMER: " << fileName << " is loaded fully resident" << "\n";
+		}
+		if(parameters.compressed){
+			return new Texture(fileName.c_str(), GL_TEXTURE_2D, parameters.format);
+		}
+		if(this->loader && parameters.mipFilter == MipGenerator::GPU && !parameters.srgb){
+			return this->loader->load(fileName.c_str());
+		}
+		return new Texture(fileName.c_str(), GL_TEXTURE_2D, parameters.mipFilter, parameters.srgb);
+	}
+
+	// Sizes change once asynchronous loads complete, so they are refreshed before every eviction pass
+	void updateMemorySize(){
+		this->memorySize = 0;
+		for(auto& i : this->entries){
+			i.second.memorySize = i.second.streamed ? 0 : i.second.texture->getMemorySize();
+			this->memorySize += i.second.memorySize;
+		}
+	}
+
+	void erase(const std::string& key){
+		Entry& entry = this->entries[key];
+		this->memorySize -= entry.memorySize;
+		this->recent.erase(entry.recent);
+		this->keys.erase(entry.texture);
+		if(!entry.streamed){
+			delete entry.texture;
+		}
+		this->entries.erase(key);
+	}
+
+public:
+	TextureCache(size_t budget = 512 << 20, TextureLoader* loader = nullptr, TextureStreamer* streamer = nullptr){
+		this->budget = budget;
+		this->memorySize = 0;
+		this->loader = loader;
+		this->streamer = streamer;
+		this->evictionPostponed = false;
+	}
+
+	~TextureCache(){
+		for(auto& i : this->entries){
+			if(!i.second.streamed){
+				delete i.second.texture;
+			}
+		}
+	}
+
+	//Accessors
+	inline size_t getNrOfTextures() const{return this->entries.size();}
+	inline size_t getMemorySize() const{return this->memorySize;}
+	inline size_t getBudget() const{return this->budget;}
+
+	//Modifiers
+	void setBudget(size_t budget){
+		this->budget = budget;
+		this->evict();
+	}
+
+	//Functions
+
+	// Returns the shared texture for the file and parameters, loading it on first use
+	Texture* acquire(const std::string& fileName, const TextureParameters& parameters = TextureParameters()){
+		std::string key = makeKey(fileName, parameters);
+		auto it = this->entries.find(key);
+		if(it != this->entries.end()){
+			Entry& entry = it->second;
+			entry.references++;
+			this->recent.splice(this->recent.begin(), this->recent, entry.recent);
+			return entry.texture;
+		}
+
+		Entry entry;
+		entry.texture = this->create(fileName, parameters);
+		entry.references = 1;
+		entry.streamed = parameters.streamed && this->streamer;
+		entry.memorySize = entry.streamed ? 0 : entry.texture->getMemorySize();
+		this->recent.push_front(key);
+		entry.recent = this->recent.begin();
+		this->entries[key] = entry;
+		this->keys[entry.texture] = key;
+		this->memorySize += entry.memorySize;
+
+		this->evict();
+		return entry.texture;
+	}
+
+	// The texture stays cached until it has to make room for others
+	void release(Texture* texture){
+		auto it = this->keys.find(texture);
+		if(it == this->keys.end()){
+			std::cout << "ERROR::TEXTURECACHE::RELEASE_OF_UNKNOWN_TEXTURE" << "\n";
+			return;
+		}
+		Entry& entry = this->entries[it->second];
+		if(entry.references == 0){
+			std::cout << "ERROR::TEXTURECACHE::TOO_MANY_RELEASES: " << it->second << "\n";
+			return;
+		}
+		entry.references--;
+		this->evict();
+	}
+
+	// Call once per frame, runs the eviction pass postponed by pending loads as soon as they are done
+	void update(){
+		if(this->evictionPostponed){
+			this->evict();
+		}
+	}
+
+	// Delete least recently used unreferenced textures until the cache fits the budget
+	void evict(){
+		// Placeholders of pending loads must outlive the loader's reference to them
+		if(this->loader && !this->loader->isIdle()){
+			this->evictionPostponed = true;
+			return;
+		}
+		this->evictionPostponed = false;
+		this->updateMemorySize();
+		auto it = this->recent.end();
+		while(this->memorySize > this->budget && it != this->recent.begin()){
+			--it;
+			if(this->entries[*it].references > 0){
+				continue;
+			}
+			std::string key = *it;
+			it++;
+			this->erase(key);
+		}
+	}
+};
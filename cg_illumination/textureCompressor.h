@@ -0,0 +1,466 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <SOIL.h>
+
+#include "mipGenerator.h"
+#include "hash.h"
+
+// S3TC is an extension in core profile headers
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// Block compressed image with its whole mip chain, level 0 first
+struct CompressedImage{
+	GLenum internalFormat;
+	std::vector<glm::ivec2> sizes;
+	std::vector<std::vector<unsigned char>> levels;
+};
+
+// CPU block compressor and on-disk cache for GPU compressed textures.
+// bake() decodes an image with SOIL, builds all mip levels with MipGenerator and encodes every 4x4 block on all
+// cores into BC1 (opaque color, 8 bytes), BC3 (color + alpha, 16 bytes), BC5 (two channels such as normal maps, 16 bytes)
+// or BC7 (16 bytes). BC7 is always encoded in mode 6, a single subset with RGBA endpoints, which is the
+// mode that suits smooth content best and keeps the encoder fast.
+// The result is cached next to the working directory, keyed by a hash of the image file and the format.
+class TextureCompressor{
+public:
+	enum Format{
+		BC1 = 0,
+		BC3,
+		BC5,
+		BC7
+	};
+
+private:
+	static const unsigned CACHE_VERSION = 2;
+
+	// Pixels of a block, RGBA
+	struct Block{
+		unsigned char pixels[16][4];
+	};
+
+	//Bit writer for BC7, least significant bit first
+	struct BitWriter{
+		unsigned char* data;
+		int position;
+
+		void write(unsigned value, int bits){
+			for(int i = 0; i < bits; i++, this->position++){
+				if(value & (1u << i)){
+					this->data[this->position >> 3] |= (unsigned char)(1u << (this->position & 7));
+				}
+			}
+		}
+	};
+
+	// Principal axis of the block colors over the first nrOfChannels channels, found by power iteration
+	static void principalAxis(const Block& block, int nrOfChannels, float mean[4], float axis[4]){
+		float covariance[4][4] = {};
+		for(int c = 0; c < 4; c++){
+			mean[c] = 0.f;
+			axis[c] = 0.f;
+		}
+		for(int i = 0; i < 16; i++){
+			for(int c = 0; c < nrOfChannels; c++){
+				mean[c] += block.pixels[i][c] / 16.f;
+			}
+		}
+		for(int i = 0; i < 16; i++){
+			for(int a = 0; a < nrOfChannels; a++){
+				for(int b = 0; b < nrOfChannels; b++){
+					covariance[a][b] += (block.pixels[i][a] - mean[a]) * (block.pixels[i][b] - mean[b]);
+				}
+			}
+		}
+		for(int c = 0; c < nrOfChannels; c++){
+			axis[c] = 1.f;
+		}
+		for(int iteration = 0; iteration < 8; iteration++){
+			float next[4] = {};
+			float length = 0.f;
+			for(int a = 0; a < nrOfChannels; a++){
+				for(int b = 0; b < nrOfChannels; b++){
+					next[a] += covariance[a][b] * axis[b];
+				}
+				length = std::max(length, std::fabs(next[a]));
+			}
+			if(length < 1e-6f){
+				break;
+			}
+			for(int c = 0; c < nrOfChannels; c++){
+				axis[c] = next[c] / length;
+			}
+		}
+	}
+
+	// Block colors at the two ends of the principal axis
+	static void endpoints(const Block& block, int nrOfChannels, float low[4], float high[4]){
+		float mean[4];
+		float axis[4];
+		principalAxis(block, nrOfChannels, mean, axis);
+		float minimum = 1e30f;
+		float maximum = -1e30f;
+		for(int i = 0; i < 16; i++){
+			float t = 0.f;
+			for(int c = 0; c < nrOfChannels; c++){
+				t += (block.pixels[i][c] - mean[c]) * axis[c];
+			}
+			minimum = std::min(minimum, t);
+			maximum = std::max(maximum, t);
+		}
+		float lengthSquared = 0.f;
+		for(int c = 0; c < nrOfChannels; c++){
+			lengthSquared += axis[c] * axis[c];
+		}
+		lengthSquared = std::max(lengthSquared, 1e-12f);
+		for(int c = 0; c < 4; c++){
+			low[c] = c < nrOfChannels ? std::min(std::max(mean[c] + axis[c] * minimum / lengthSquared, 0.f), 255.f) : 255.f;
+			high[c] = c < nrOfChannels ? std::min(std::max(mean[c] + axis[c] * maximum / lengthSquared, 0.f), 255.f) : 255.f;
+		}
+	}
+
+	static unsigned short packRGB565(const float color[4]){
+		unsigned r = (unsigned)(color[0] * 31.f / 255.f + 0.5f);
+		unsigned g = (unsigned)(color[1] * 63.f / 255.f + 0.5f);
+		unsigned b = (unsigned)(color[2] * 31.f / 255.f + 0.5f);
+		return (unsigned short)((r << 11) | (g << 5) | b);
+	}
+
+	static void unpackRGB565(unsigned short packed, int color[3]){
+		color[0] = ((packed >> 11) & 31) * 255 / 31;
+		color[1] = ((packed >> 5) & 63) * 255 / 63;
+		color[2] = (packed & 31) * 255 / 31;
+	}
+
+	// 4 color BC1 block, always opaque
+	static void encodeBC1(const Block& block, unsigned char* out){
+		float low[4];
+		float high[4];
+		endpoints(block, 3, low, high);
+		unsigned short color0 = packRGB565(high);
+		unsigned short color1 = packRGB565(low);
+		if(color0 < color1){
+			std::swap(color0, color1);
+		}
+
+		unsigned indices = 0;
+		if(color0 != color1){
+			int palette[4][3];
+			unpackRGB565(color0, palette[0]);
+			unpackRGB565(color1, palette[1]);
+			for(int c = 0; c < 3; c++){
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+			for(int i = 0; i < 16; i++){
+				int best = 0;
+				int bestError = 1 << 30;
+				for(int p = 0; p < 4; p++){
+					int error = 0;
+					for(int c = 0; c < 3; c++){
+						int d = block.pixels[i][c] - palette[p][c];
+						error += d * d;
+					}
+					if(error < bestError){
+						bestError = error;
+						best = p;
+					}
+				}
+				indices |= (unsigned)best << (2 * i);
+			}
+		}
+
+		out[0] = color0 & 255;
+		out[1] = color0 >> 8;
+		out[2] = color1 & 255;
+		out[3] = color1 >> 8;
+		for(int i = 0; i < 4; i++){
+			out[4 + i] = (indices >> (8 * i)) & 255;
+		}
+	}
+
+	// 8 value BC4 block of one channel, used for BC3 alpha and both BC5 channels
+	static void encodeBC4(const Block& block, int channel, unsigned char* out){
+		int minimum = 255;
+		int maximum = 0;
+		for(int i = 0; i < 16; i++){
+			minimum = std::min(minimum, (int)block.pixels[i][channel]);
+			maximum = std::max(maximum, (int)block.pixels[i][channel]);
+		}
+		out[0] = (unsigned char)maximum;
+		out[1] = (unsigned char)minimum;
+
+		unsigned long long indices = 0;
+		if(maximum != minimum){
+			int palette[8];
+			palette[0] = maximum;
+			palette[1] = minimum;
+			for(int p = 2; p < 8; p++){
+				palette[p] = ((8 - p) * maximum + (p - 1) * minimum) / 7;
+			}
+			for(int i = 0; i < 16; i++){
+				int best = 0;
+				int bestError = 1 << 30;
+				for(int p = 0; p < 8; p++){
+					int error = std::abs(block.pixels[i][channel] - palette[p]);
+					if(error < bestError){
+						bestError = error;
+						best = p;
+					}
+				}
+				indices |= (unsigned long long)best << (3 * i);
+			}
+		}
+		for(int i = 0; i < 6; i++){
+			out[2 + i] = (indices >> (8 * i)) & 255;
+		}
+	}
+
+	// BC7 mode 6: 7 bit RGBA endpoints with one shared low bit each, 4 bit indices
+	static void encodeBC7(const Block& block, unsigned char* out){
+		static const int weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+		float ends[2][4];
+		endpoints(block, 4, ends[0], ends[1]);
+
+		// Quantize each endpoint with the low bit that reproduces it best
+		int quantized[2][4];
+		int pbits[2];
+		int colors[2][4];
+		for(int e = 0; e < 2; e++){
+			int bestError = 1 << 30;
+			for(int p = 0; p < 2; p++){
+				int values[4];
+				int error = 0;
+				for(int c = 0; c < 4; c++){
+					values[c] = std::min(std::max((int)std::floor((ends[e][c] - p) / 2.f + 0.5f), 0), 127);
+					int d = ((values[c] << 1) | p) - (int)(ends[e][c] + 0.5f);
+					error += d * d;
+				}
+				if(error < bestError){
+					bestError = error;
+					pbits[e] = p;
+					for(int c = 0; c < 4; c++){
+						quantized[e][c] = values[c];
+						colors[e][c] = (values[c] << 1) | p;
+					}
+				}
+			}
+		}
+
+		int palette[16][4];
+		for(int w = 0; w < 16; w++){
+			for(int c = 0; c < 4; c++){
+				palette[w][c] = ((64 - weights[w]) * colors[0][c] + weights[w] * colors[1][c] + 32) >> 6;
+			}
+		}
+		int indices[16];
+		for(int i = 0; i < 16; i++){
+			int bestError = 1 << 30;
+			for(int w = 0; w < 16; w++){
+				int error = 0;
+				for(int c = 0; c < 4; c++){
+					int d = block.pixels[i][c] - palette[w][c];
+					error += d * d;
+				}
+				if(error < bestError){
+					bestError = error;
+					indices[i] = w;
+				}
+			}
+		}
+
+		// The most significant index bit of the first texel is implicit zero, swap the endpoints to make it so
+		if(indices[0] >= 8){
+			for(int c = 0; c < 4; c++){
+				std::swap(quantized[0][c], quantized[1][c]);
+			}
+			std::swap(pbits[0], pbits[1]);
+			for(int i = 0; i < 16; i++){
+				indices[i] = 15 - indices[i];
+			}
+		}
+
+		std::memset(out, 0, 16);
+		BitWriter writer = {out, 0};
+		writer.write(1 << 6, 7);
+		for(int c = 0; c < 4; c++){
+			writer.write(quantized[0][c], 7);
+			writer.write(quantized[1][c], 7);
+		}
+		writer.write(pbits[0], 1);
+		writer.write(pbits[1], 1);
+		writer.write(indices[0], 3);
+		for(int i = 1; i < 16; i++){
+			writer.write(indices[i], 4);
+		}
+	}
+
+	static std::string cachePath(const char* fileName, Format format){
+		std::stringstream path;
+		path << "tex_" << std::hex << std::setw(16) << std::setfill('0') << Hash::file(fileName)
+			<< std::dec << "_bc" << (format == BC1 ? 1 : format == BC3 ? 3 : format == BC5 ? 5 : 7) << ".ctex";
+		return path.str();
+	}
+
+public:
+	static GLenum getInternalFormat(Format format){
+		switch(format){
+			case BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+			case BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+			case BC5: return GL_COMPRESSED_RG_RGTC2;
+			default: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+		}
+	}
+
+	static int getBlockSize(Format format){
+		return format == BC1 ? 8 : 16;
+	}
+
+	// Compress one RGBA level, block rows are spread over all cores
+	static std::vector<unsigned char> compress(const unsigned char* image, int width, int height, Format format){
+		int blocksX = (width + 3) / 4;
+		int blocksY = (height + 3) / 4;
+		int blockSize = getBlockSize(format);
+		std::vector<unsigned char> result((size_t)blocksX * blocksY * blockSize);
+
+		std::atomic<int> next(0);
+		auto worker = [&](){
+			for(int by = next++; by < blocksY; by = next++){
+				for(int bx = 0; bx < blocksX; bx++){
+					// Gather the block, texels outside the image repeat the edge
+					Block block;
+					for(int i = 0; i < 16; i++){
+						int x = std::min(bx * 4 + (i & 3), width - 1);
+						int y = std::min(by * 4 + (i >> 2), height - 1);
+						std::memcpy(block.pixels[i], &image[((size_t)y * width + x) * 4], 4);
+					}
+
+					unsigned char* out = &result[((size_t)by * blocksX + bx) * blockSize];
+					switch(format){
+						case BC1:
+							encodeBC1(block, out);
+							break;
+						case BC3:
+							encodeBC4(block, 3, out);
+							encodeBC1(block, out + 8);
+							break;
+						case BC5:
+							encodeBC4(block, 0, out);
+							encodeBC4(block, 1, out + 8);
+							break;
+						default:
+							encodeBC7(block, out);
+							break;
+					}
+				}
+			}
+		};
+
+		unsigned nrOfThreads = std::max(1u, std::min(std::thread::hardware_concurrency(), (unsigned)blocksY));
+		std::vector<std::thread> threads;
+		for(unsigned i = 0; i < nrOfThreads; i++){
+			threads.push_back(std::thread(worker));
+		}
+		for(auto& i : threads){
+			i.join();
+		}
+		return result;
+	}
+
+	// Decode, build the mip chain and compress every level
+	static bool bake(const char* fileName, Format format, CompressedImage& compressed){
+		int width;
+		int height;
+		unsigned char* image = SOIL_load_image(fileName, &width, &height, NULL, SOIL_LOAD_RGBA);
+		if(!image){
+			std::cout << "ERROR::TEXTURECOMPRESSOR::TEXTURE_LOADING_FAILED: " << fileName << "\n";
+			return false;
+		}
+		std::vector<std::vector<unsigned char>> levels;
+		MipGenerator::generate(image, width, height, MipGenerator::KAISER, false, levels, compressed.sizes);
+		SOIL_free_image_data(image);
+
+		compressed.internalFormat = getInternalFormat(format);
+		compressed.levels.resize(levels.size());
+		for(size_t i = 0; i < levels.size(); i++){
+			compressed.levels[i] = compress(levels[i].data(), compressed.sizes[i].x, compressed.sizes[i].y, format);
+		}
+		return true;
+	}
+
+	static bool loadCache(const std::string& path, CompressedImage& compressed){
+		std::ifstream in_file(path, std::ios::binary);
+		if(!in_file){
+			return false;
+		}
+		unsigned version = 0;
+		unsigned nrOfLevels = 0;
+		in_file.read((char*)&version, sizeof(version));
+		if(version != CACHE_VERSION){
+			return false;
+		}
+		in_file.read((char*)&compressed.internalFormat, sizeof(compressed.internalFormat));
+		in_file.read((char*)&nrOfLevels, sizeof(nrOfLevels));
+		compressed.sizes.resize(nrOfLevels);
+		compressed.levels.resize(nrOfLevels);
+		for(unsigned i = 0; i < nrOfLevels && in_file; i++){
+			unsigned size = 0;
+			in_file.read((char*)&compressed.sizes[i], sizeof(glm::ivec2));
+			in_file.read((char*)&size, sizeof(size));
+			compressed.levels[i].resize(size);
+			in_file.read((char*)compressed.levels[i].data(), size);
+		}
+		return (bool)in_file && nrOfLevels > 0;
+	}
+
+	static void saveCache(const std::string& path, const CompressedImage& compressed){
+		std::ofstream out_file(path, std::ios::binary);
+		if(!out_file){
+			std::cout << "ERROR::TEXTURECOMPRESSOR::COULD_NOT_WRITE_CACHE: " << path << "\n";
+			return;
+		}
+		unsigned version = CACHE_VERSION;
+		unsigned nrOfLevels = (unsigned)compressed.levels.size();
+		out_file.write((const char*)&version, sizeof(version));
+		out_file.write((const char*)&compressed.internalFormat, sizeof(compressed.internalFormat));
+		out_file.write((const char*)&nrOfLevels, sizeof(nrOfLevels));
+		for(unsigned i = 0; i < nrOfLevels; i++){
+			unsigned size = (unsigned)compressed.levels[i].size();
+			out_file.write((const char*)&compressed.sizes[i], sizeof(glm::ivec2));
+			out_file.write((const char*)&size, sizeof(size));
+			out_file.write((const char*)compressed.levels[i].data(), size);
+		}
+	}
+
+	// Loads the compressed mip chain from the cache, baking and storing it first if needed
+	static bool load(const char* fileName, Format format, CompressedImage& compressed){
+		std::string path = cachePath(fileName, format);
+		if(loadCache(path, compressed)){
+			return true;
+		}
+		if(!bake(fileName, format, compressed)){
+			return false;
+		}
+		saveCache(path, compressed);
+		return true;
+	}
+};
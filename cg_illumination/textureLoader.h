@@ -0,0 +1,238 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+
+#include <glad/glad.h>
+#include <SOIL.h>
+
+#include "texture.h"
+
+// Loads textures without stalling the render thread.
+// load() returns at once with a 1x1 placeholder texture, the file is decoded by SOIL on a pool of worker threads
+// and update(), called once per frame on the GL thread, streams finished images through pixel buffer objects
+// into the same texture id. A texture counts as loaded once the fence behind its upload has signaled,
+// at which point the decode and total latency are reported.
+class TextureLoader{
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Request{
+		std::string path;
+		Texture* texture;
+		Clock::time_point requested;
+		double decodeTime;          // Milliseconds spent in SOIL
+		int width;
+		int height;
+		unsigned char* image;
+	};
+
+	// Pixel buffers are reused once the GPU has consumed the upload that went through them
+	struct PixelBuffer{
+		GLuint buffer;
+		GLsizeiptr size;
+		GLsync fence;
+		Request request;
+	};
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::deque<Request> pending;
+	std::deque<Request> decoded;
+	bool running;
+
+	std::vector<PixelBuffer> pixelBuffers;
+	GLsizeiptr uploadBudget;
+	size_t nrOfLoading;
+
+	static double milliseconds(Clock::time_point start, Clock::time_point end){
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	}
+
+	void work(){
+		while(true){
+			Request request;
+			{
+				std::unique_lock<std::mutex> lock(this->mutex);
+				this->condition.wait(lock, [this](){return !this->running || !this->pending.empty();});
+				if(!this->running){
+					return;
+				}
+				request = this->pending.front();
+				this->pending.pop_front();
+			}
+
+			Clock::time_point start = Clock::now();
+			request.image = SOIL_load_image(request.path.c_str(), &request.width, &request.height, NULL, SOIL_LOAD_RGBA);
+			request.decodeTime = milliseconds(start, Clock::now());
+
+			std::lock_guard<std::mutex> lock(this->mutex);
+			this->decoded.push_back(request);
+		}
+	}
+
+	// Returns true once the upload through this buffer is done, the buffer is then free again
+	bool retire(PixelBuffer& pixelBuffer){
+		if(!pixelBuffer.fence){
+			return true;
+		}
+		GLenum result = glClientWaitSync(pixelBuffer.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+		if(result == GL_TIMEOUT_EXPIRED){
+			return false;
+		}
+		glDeleteSync(pixelBuffer.fence);
+		pixelBuffer.fence = 0;
+
+		Request& request = pixelBuffer.request;
+		std::cout << "TEXTURELOADER::LOADED: " << request.path << " " << request.width << "x" << request.height
+			<< " decode " << request.decodeTime << "ms, total " << milliseconds(request.requested, Clock::now()) << "ms" << "\n";
+		this->nrOfLoading--;
+		return true;
+	}
+
+	void upload(PixelBuffer& pixelBuffer, Request& request){
+		GLsizeiptr size = (GLsizeiptr)request.width * request.height * 4;
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer.buffer);
+		if(size > pixelBuffer.size){
+			pixelBuffer.size = size;
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+		}
+		// The buffer is idle (its fence has signaled), so it can be written without synchronization
+		void* data = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		if(data){
+			std::memcpy(data, request.image, size);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			// Copies from the buffer asynchronously, the driver does not need to touch client memory
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+			request.texture->setImage(request.width, request.height, 0);
+		}else{
+			std::cout << "ERROR::TEXTURELOADER::COULD_NOT_MAP_PIXEL_BUFFER: " << request.path << "\n";
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+		SOIL_free_image_data(request.image);
+		request.image = nullptr;
+		pixelBuffer.request = request;
+		pixelBuffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+public:
+	TextureLoader(unsigned nrOfThreads = 0, unsigned nrOfPixelBuffers = 4, GLsizeiptr uploadBudget = 16 << 20){
+		this->running = true;
+		this->uploadBudget = uploadBudget;
+		this->nrOfLoading = 0;
+
+		this->pixelBuffers.resize(nrOfPixelBuffers);
+		for(auto& i : this->pixelBuffers){
+			glGenBuffers(1, &i.buffer);
+			i.size = 0;
+			i.fence = 0;
+		}
+
+		// Leave one core to the render thread
+		if(nrOfThreads == 0){
+			nrOfThreads = std::max(2u, std::thread::hardware_concurrency()) - 1;
+		}
+		for(unsigned i = 0; i < nrOfThreads; i++){
+			this->workers.push_back(std::thread(&TextureLoader::work, this));
+		}
+	}
+
+	~TextureLoader(){
+		{
+			std::lock_guard<std::mutex> lock(this->mutex);
+			this->running = false;
+		}
+		this->condition.notify_all();
+		for(auto& i : this->workers){
+			i.join();
+		}
+
+		for(auto& i : this->decoded){
+			SOIL_free_image_data(i.image);
+		}
+		for(auto& i : this->pixelBuffers){
+			if(i.fence){
+				glDeleteSync(i.fence);
+			}
+			glDeleteBuffers(1, &i.buffer);
+		}
+	}
+
+	//Accessors
+	inline size_t getNrOfLoading() const{return this->nrOfLoading;}
+	inline bool isIdle() const{return this->nrOfLoading == 0;}
+
+	//Functions
+
+	// Returns a placeholder texture that receives the image on a later frame, the caller owns the texture
+	// and has to keep it alive until the loader is idle
+	Texture* load(const char* fileName, GLenum type = GL_TEXTURE_2D){
+		unsigned char white[4] = {255, 255, 255, 255};
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		Texture* texture = new Texture(type, GL_RGBA, 1, 1, white);
+
+		Request request;
+		request.path = fileName;
+		request.texture = texture;
+		request.requested = Clock::now();
+		request.decodeTime = 0.0;
+		request.width = 0;
+		request.height = 0;
+		request.image = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(this->mutex);
+			this->pending.push_back(request);
+		}
+		this->condition.notify_one();
+		this->nrOfLoading++;
+		return texture;
+	}
+
+	// Call once per frame on the GL thread: finishes uploads the GPU is done with and starts new ones,
+	// at most uploadBudget bytes per frame (at least one image, so large images don't starve)
+	void update(){
+		GLsizeiptr uploaded = 0;
+		for(auto& i : this->pixelBuffers){
+			if(!this->retire(i) || uploaded >= this->uploadBudget){
+				continue;
+			}
+
+			Request request;
+			{
+				std::lock_guard<std::mutex> lock(this->mutex);
+				if(this->decoded.empty()){
+					continue;
+				}
+				request = this->decoded.front();
+				this->decoded.pop_front();
+			}
+
+			if(!request.image){
+				std::cout << "ERROR::TEXTURELOADER::TEXTURE_LOADING_FAILED: " << request.path << "\n";
+				this->nrOfLoading--;
+				continue;
+			}
+			uploaded += (GLsizeiptr)request.width * request.height * 4;
+			this->upload(i, request);
+		}
+	}
+
+	// Blocks until every requested texture is uploaded, for loading screens
+	void finish(){
+		while(this->nrOfLoading > 0){
+			this->update();
+			std::this_thread::yield();
+		}
+	}
+};
@@ -0,0 +1,314 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <cmath>
+
+#include <glad/glad.h>
+#include <SOIL.h>
+
+#include "texture.h"
+#include "mipGenerator.h"
+#include "object.h"
+
+// Keeps only the mip levels of textures resident that their Objects need on screen.
+// A streamed texture starts as its mip tail (the levels no larger than tailSize). Every frame the caller
+// reports the projected size of the Objects using a texture with request(), update() then picks a target
+// level per texture, the largest projections first, so that all resident levels fit in the memory budget.
+// Missing levels are decoded and filtered by background I/O threads and attached on the GL thread by
+// recreating the texture one level chain larger, the levels already resident are copied on the GPU.
+// Textures nobody requested for a while drop back to their tail.
+class TextureStreamer{
+private:
+	struct Entry{
+		std::string path;
+		Texture* texture;
+		glm::ivec2 size;            // Size of level 0 of the full chain, 0 until the tail is loaded
+		int nrOfLevels;             // Levels of the full chain
+		int tailLevel;
+		int residentLevel;          // Largest level on the GPU
+		int targetLevel;
+		float screenSize;           // Largest projected size in pixels of the last frame it was requested
+		unsigned lastRequested;
+		bool pending;
+	};
+
+	// Levels [firstLevel, lastLevel) of a file, firstLevel is -1 for the initial tail
+	struct Job{
+		Entry* entry;
+		int firstLevel;
+		int lastLevel;
+		glm::ivec2 size;
+		std::vector<std::vector<unsigned char>> levels;
+		bool loaded;
+	};
+
+	std::vector<Entry*> entries;
+	size_t budget;
+	int tailSize;
+	unsigned frame;
+	unsigned keepFrames;
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::deque<Job> jobs;
+	std::deque<Job> finished;
+	bool running;
+
+	static size_t levelsMemorySize(glm::ivec2 size, int firstLevel, int nrOfLevels){
+		size_t memorySize = 0;
+		for(int i = firstLevel; i < nrOfLevels; i++){
+			memorySize += (size_t)std::max(1, size.x >> i) * std::max(1, size.y >> i) * 4;
+		}
+		return memorySize;
+	}
+
+	void work(){
+		while(true){
+			Job job;
+			{
+				std::unique_lock<std::mutex> lock(this->mutex);
+				this->condition.wait(lock, [this](){return !this->running || !this->jobs.empty();});
+				if(!this->running){
+					return;
+				}
+				job = this->jobs.front();
+				this->jobs.pop_front();
+			}
+
+			// Files are decoded again for every request so only the resident levels take memory
+			int width;
+			int height;
+			unsigned char* image = SOIL_load_image(job.entry->path.c_str(), &width, &height, NULL, SOIL_LOAD_RGBA);
+			job.loaded = image != nullptr;
+			if(image){
+				std::vector<std::vector<unsigned char>> levels;
+				std::vector<glm::ivec2> sizes;
+				MipGenerator::generate(image, width, height, MipGenerator::BOX, false, levels, sizes);
+				SOIL_free_image_data(image);
+
+				job.size = glm::ivec2(width, height);
+				if(job.firstLevel < 0){
+					job.firstLevel = 0;
+					while(job.firstLevel + 1 < (int)sizes.size() && std::max(sizes[job.firstLevel].x, sizes[job.firstLevel].y) > this->tailSize){
+						job.firstLevel++;
+					}
+					job.lastLevel = (int)sizes.size();
+				}
+				job.levels.assign(levels.begin() + job.firstLevel, levels.begin() + job.lastLevel);
+			}
+
+			std::lock_guard<std::mutex> lock(this->mutex);
+			this->finished.push_back(job);
+		}
+	}
+
+	void submit(const Job& job){
+		{
+			std::lock_guard<std::mutex> lock(this->mutex);
+			this->jobs.push_back(job);
+		}
+		this->condition.notify_one();
+	}
+
+	// Attach the levels of a finished job to its texture
+	void complete(Job& job){
+		Entry* entry = job.entry;
+		entry->pending = false;
+		if(!job.loaded){
+			std::cout << "ERROR::TEXTURESTREAMER::TEXTURE_LOADING_FAILED: " << entry->path << "\n";
+			return;
+		}
+
+		if(entry->size.x == 0){
+			entry->size = job.size;
+			entry->nrOfLevels = MipGenerator::getNrOfLevels(job.size.x, job.size.y);
+			entry->tailLevel = job.firstLevel;
+			entry->residentLevel = entry->nrOfLevels;
+			entry->targetLevel = job.firstLevel;
+		}
+		// Levels may have been dropped or the target may have moved while the job was running. A job that no
+		// longer reaches down to the resident levels would leave a gap, it is discarded and update() asks again.
+		int top = std::max(job.firstLevel, entry->targetLevel);
+		int kept = entry->residentLevel;
+		if(top >= kept || job.lastLevel < kept){
+			return;
+		}
+
+		entry->texture->resizeStorage(std::max(1, entry->size.x >> top), std::max(1, entry->size.y >> top));
+		for(int level = top; level < std::min(kept, job.lastLevel); level++){
+			entry->texture->uploadLevel(level - top, job.levels[level - job.firstLevel].data());
+		}
+		entry->residentLevel = top;
+	}
+
+	// Finest level whose texels are no smaller than the pixels covered on screen
+	int levelForScreenSize(const Entry* entry) const{
+		float largest = (float)std::max(entry->size.x, entry->size.y);
+		if(entry->screenSize <= 0.f){
+			return entry->tailLevel;
+		}
+		int level = (int)std::floor(std::log2(std::max(largest / entry->screenSize, 1.f)));
+		return std::min(level, entry->tailLevel);
+	}
+
+public:
+	TextureStreamer(size_t budget = 128 << 20, int tailSize = 64, unsigned nrOfThreads = 2, unsigned keepFrames = 120){
+		this->budget = budget;
+		this->tailSize = tailSize;
+		this->frame = 0;
+		this->keepFrames = keepFrames;
+		this->running = true;
+		for(unsigned i = 0; i < std::max(1u, nrOfThreads); i++){
+			this->workers.push_back(std::thread(&TextureStreamer::work, this));
+		}
+	}
+
+	~TextureStreamer(){
+		{
+			std::lock_guard<std::mutex> lock(this->mutex);
+			this->running = false;
+		}
+		this->condition.notify_all();
+		for(auto& i : this->workers){
+			i.join();
+		}
+		for(auto& i : this->entries){
+			delete i->texture;
+			delete i;
+		}
+	}
+
+	//Accessors
+	inline size_t getBudget() const{return this->budget;}
+
+	size_t getMemorySize() const{
+		size_t memorySize = 0;
+		for(auto& i : this->entries){
+			memorySize += i->texture->getMemorySize();
+		}
+		return memorySize;
+	}
+
+	//Functions
+
+	// Returns a placeholder that receives the mip tail of the file on a later frame, the streamer owns the texture.
+	// Loading a file again returns the same texture.
+	Texture* load(const char* fileName){
+		for(auto& i : this->entries){
+			if(i->path == fileName){
+				return i->texture;
+			}
+		}
+
+		unsigned char white[4] = {255, 255, 255, 255};
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+		Entry* entry = new Entry();
+		entry->path = fileName;
+		entry->texture = new Texture(GL_TEXTURE_2D, GL_RGBA, 1, 1, white);
+		entry->size = glm::ivec2(0);
+		entry->nrOfLevels = 1;
+		entry->tailLevel = 0;
+		entry->residentLevel = 0;
+		entry->targetLevel = 0;
+		entry->screenSize = 0.f;
+		entry->lastRequested = this->frame;
+		entry->pending = true;
+		this->entries.push_back(entry);
+
+		Job job;
+		job.entry = entry;
+		job.firstLevel = -1;
+		job.lastLevel = -1;
+		job.loaded = false;
+		this->submit(job);
+		return entry->texture;
+	}
+
+	// Report that texture covers about screenSize pixels on screen this frame
+	void request(const Texture* texture, float screenSize){
+		for(auto& i : this->entries){
+			if(i->texture == texture){
+				i->screenSize = i->lastRequested == this->frame ? std::max(i->screenSize, screenSize) : screenSize;
+				i->lastRequested = this->frame;
+				return;
+			}
+		}
+	}
+
+	// Requests the textures of an object by the projected diameter of its meshes' bounding spheres
+	void request(Object* object, const glm::mat4& view, const glm::mat4& projection, float viewportHeight){
+		float screenSize = 0.f;
+		for(auto& i : object->getMeshes()){
+			glm::vec4 sphere = i->getWorldBoundingSphere();
+			float distance = std::max(-(view * glm::vec4(glm::vec3(sphere), 1.f)).z, 1e-3f);
+			// projection[1][1] is the cotangent of half the vertical field of view
+			screenSize = std::max(screenSize, sphere.w * projection[1][1] * viewportHeight / distance);
+		}
+		this->request(object->getTextureDiffuse(), screenSize);
+		this->request(object->getTextureSpecular(), screenSize);
+	}
+
+	// Call once per frame on the GL thread, after all requests
+	void update(){
+		{
+			std::deque<Job> finished;
+			{
+				std::lock_guard<std::mutex> lock(this->mutex);
+				std::swap(finished, this->finished);
+			}
+			for(auto& i : finished){
+				this->complete(i);
+			}
+		}
+
+		// Tails are always resident, the rest of the budget goes to the largest projections first
+		std::vector<Entry*> loaded;
+		size_t remaining = this->budget;
+		for(auto& i : this->entries){
+			if(i->size.x == 0){
+				continue;
+			}
+			if(this->frame - i->lastRequested > this->keepFrames){
+				i->screenSize = 0.f;
+			}
+			loaded.push_back(i);
+			size_t tail = levelsMemorySize(i->size, i->tailLevel, i->nrOfLevels);
+			remaining -= std::min(remaining, tail);
+		}
+		std::sort(loaded.begin(), loaded.end(), [](const Entry* a, const Entry* b){return a->screenSize > b->screenSize;});
+
+		for(auto& i : loaded){
+			size_t tail = levelsMemorySize(i->size, i->tailLevel, i->nrOfLevels);
+			int level = this->levelForScreenSize(i);
+			while(level < i->tailLevel && levelsMemorySize(i->size, level, i->nrOfLevels) - tail > remaining){
+				level++;
+			}
+			remaining -= levelsMemorySize(i->size, level, i->nrOfLevels) - tail;
+			i->targetLevel = level;
+
+			// Dropping levels needs no I/O, adding them is done by the workers
+			if(level > i->residentLevel){
+				i->texture->resizeStorage(std::max(1, i->size.x >> level), std::max(1, i->size.y >> level));
+				i->residentLevel = level;
+			}else if(level < i->residentLevel && !i->pending){
+				Job job;
+				job.entry = i;
+				job.firstLevel = level;
+				job.lastLevel = i->residentLevel;
+				job.loaded = false;
+				i->pending = true;
+				this->submit(job);
+			}
+		}
+		this->frame++;
+	}
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vector>
+
+#include <emmintrin.h>
+
+#include <glm/glm.hpp>
+
+// Per draw matrices as the vertex shaders read them, std430 compatible.
+// The normal matrix is stored in the upper 3x3 of a mat4 to avoid vec3 padding rules.
+struct DrawTransform{
+	glm::mat4 model;
+	glm::mat4 mvp;
+	glm::mat4 normalMatrix;
+};
+
+// a.yzx * b.zxy - a.zxy * b.yzx
+inline __m128 crossSSE(__m128 a, __m128 b){
+	__m128 aYZX = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+	__m128 bYZX = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+	__m128 c = _mm_sub_ps(_mm_mul_ps(a, bYZX), _mm_mul_ps(aYZX, b));
+	return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+}
+
+// Computes model-view-projection and inverse transpose normal matrices for a whole batch of draws with SSE.
+// The normal matrix is the cofactor matrix of the upper 3x3 divided by its determinant,
+// which is correct for non-uniform scale, unlike mat3(model).
+inline void computeDrawTransforms(const glm::mat4& viewProjection, const glm::mat4* models, DrawTransform* out, size_t count){
+	__m128 vp0 = _mm_loadu_ps(&viewProjection[0][0]);
+	__m128 vp1 = _mm_loadu_ps(&viewProjection[1][0]);
+	__m128 vp2 = _mm_loadu_ps(&viewProjection[2][0]);
+	__m128 vp3 = _mm_loadu_ps(&viewProjection[3][0]);
+	__m128 mask3 = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+
+	for(size_t i = 0; i < count; i++){
+		const glm::mat4& model = models[i];
+		DrawTransform& transform = out[i];
+		__m128 columns[4];
+
+		// mvp = viewProjection * model, one column at a time
+		for(int c = 0; c < 4; c++){
+			columns[c] = _mm_loadu_ps(&model[c][0]);
+			__m128 x = _mm_shuffle_ps(columns[c], columns[c], _MM_SHUFFLE(0, 0, 0, 0));
+			__m128 y = _mm_shuffle_ps(columns[c], columns[c], _MM_SHUFFLE(1, 1, 1, 1));
+			__m128 z = _mm_shuffle_ps(columns[c], columns[c], _MM_SHUFFLE(2, 2, 2, 2));
+			__m128 w = _mm_shuffle_ps(columns[c], columns[c], _MM_SHUFFLE(3, 3, 3, 3));
+			__m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vp0, x), _mm_mul_ps(vp1, y)), _mm_add_ps(_mm_mul_ps(vp2, z), _mm_mul_ps(vp3, w)));
+			_mm_storeu_ps(&transform.mvp[c][0], r);
+			_mm_storeu_ps(&transform.model[c][0], columns[c]);
+		}
+
+		// inverse transpose of the upper 3x3 = (b x c, c x a, a x b) / det
+		__m128 a = _mm_and_ps(columns[0], mask3);
+		__m128 b = _mm_and_ps(columns[1], mask3);
+		__m128 c = _mm_and_ps(columns[2], mask3);
+		__m128 bc = crossSSE(b, c);
+		__m128 ca = crossSSE(c, a);
+		__m128 ab = crossSSE(a, b);
+
+		__m128 d = _mm_mul_ps(a, bc);
+		d = _mm_add_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(2, 3, 0, 1)));
+		d = _mm_add_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(1, 0, 3, 2)));
+		__m128 invDet = _mm_div_ps(_mm_set1_ps(1.f), d);
+
+		_mm_storeu_ps(&transform.normalMatrix[0][0], _mm_mul_ps(bc, invDet));
+		_mm_storeu_ps(&transform.normalMatrix[1][0], _mm_mul_ps(ca, invDet));
+		_mm_storeu_ps(&transform.normalMatrix[2][0], _mm_mul_ps(ab, invDet));
+		_mm_storeu_ps(&transform.normalMatrix[3][0], _mm_set_ps(1.f, 0.f, 0.f, 0.f));
+	}
+}
+
+inline void computeDrawTransforms(const glm::mat4& viewProjection, const std::vector<glm::mat4>& models, std::vector<DrawTransform>& out){
+	out.resize(models.size());
+	if(!models.empty()){
+		computeDrawTransforms(viewProjection, models.data(), out.data(), models.size());
+	}
+}